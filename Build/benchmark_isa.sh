@@ -0,0 +1,36 @@
+#!/bin/sh
+
+# Builds every ISA level with MULTI_ISA, runs the step and controllers benchmarks on each level this CPU supports
+# and prints the milliseconds per step of every level as a markdown table.
+
+if [ -z $1 ] 
+then
+	COMPILER=clang++
+else
+	COMPILER=$1
+	shift
+fi
+
+echo Usage: ./benchmark_isa.sh [Compiler]
+
+BUILD_DIR=Linux_Distribution_MultiIsa
+cmake -S . -B $BUILD_DIR -G "Unix Makefiles" -DCMAKE_BUILD_TYPE=Distribution -DCMAKE_CXX_COMPILER=$COMPILER -DMULTI_ISA=ON "${@}" > /dev/null || exit 1
+cmake --build $BUILD_DIR --target Benchmark -j 8 > /dev/null || exit 1
+
+echo
+echo "| ISA | step, origin (ms) | step, 10 km (ms) | controllers, serial (ms) | controllers, step listeners (ms) |"
+echo "|-----|------------------:|-----------------:|-------------------------:|---------------------------------:|"
+for ISA in SSE2 AVX2 AVX512
+do
+	OUTPUT=$(JOLT_ISA=$ISA ./$BUILD_DIR/Benchmark step controllers 2>&1)
+	if [ $? -ne 0 ]
+	then
+		echo "| $ISA | not supported | | | |"
+		continue
+	fi
+	echo "$OUTPUT" | awk -v isa=$ISA '
+		/offset/ { for (i = 1; i < NF; ++i) if ($i == "avg") step[++steps] = $(i + 1) }
+		/serial main loop:/ { serial = $4 }
+		/step listeners/ { listeners = $5 }
+		END { printf "| %s | %s | %s | %s | %s |\n", isa, step[1], step[2], serial, listeners }'
+done
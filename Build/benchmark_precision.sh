@@ -0,0 +1,22 @@
+#!/bin/sh
+
+# Builds the Benchmark executable once with single and once with double precision and runs the step benchmark on both,
+# so the cost of DOUBLE_PRECISION can be compared on the same scene.
+
+if [ -z $1 ] 
+then
+	COMPILER=clang++
+else
+	COMPILER=$1
+	shift
+fi
+
+echo Usage: ./benchmark_precision.sh [Compiler]
+
+for PRECISION in OFF ON
+do
+	BUILD_DIR=Linux_Distribution_Double$PRECISION
+	cmake -S . -B $BUILD_DIR -G "Unix Makefiles" -DCMAKE_BUILD_TYPE=Distribution -DCMAKE_CXX_COMPILER=$COMPILER -DDOUBLE_PRECISION=$PRECISION "${@}" > /dev/null || exit 1
+	cmake --build $BUILD_DIR --target Benchmark -j 8 > /dev/null || exit 1
+	./$BUILD_DIR/Benchmark step
+done
@@ -0,0 +1,405 @@
+#include "body_instance_cache.hpp"
+
+#include <Jolt/Physics/Body/BodyLock.h>
+#include <Jolt/Physics/Body/BodyLockInterface.h>
+
+#include <algorithm>
+#include <cstddef>
+
+BodyInstanceCache::BodyInstanceCache(PhysicsDebugRenderer &renderer) : renderer(renderer)
+{
+}
+
+BodyInstanceCache::~BodyInstanceCache()
+{
+    if (!gl_context_is_alive())
+        return;
+
+    for (Group &group : groups)
+    {
+        glDeleteVertexArrays(1, &group.VAO);
+        glDeleteBuffers(1, &group.instanceVBO);
+    }
+}
+
+void BodyInstanceCache::OnBodyActivated(const JPH::BodyID &inBodyID, JPH::uint64 inBodyUserData)
+{
+    MarkActive(inBodyID, true);
+
+    if (forward != nullptr)
+        forward->OnBodyActivated(inBodyID, inBodyUserData);
+}
+
+void BodyInstanceCache::OnBodyDeactivated(const JPH::BodyID &inBodyID, JPH::uint64 inBodyUserData)
+{
+    MarkActive(inBodyID, false);
+
+    if (forward != nullptr)
+        forward->OnBodyDeactivated(inBodyID, inBodyUserData);
+}
+
+void BodyInstanceCache::MarkActive(const JPH::BodyID &id, bool active)
+{
+    std::lock_guard<std::mutex> lock(activeMutex);
+
+    JPH::uint32 index = id.GetIndex();
+    if (index >= activeIndex.size())
+        activeIndex.resize(index + 1, cNotActive);
+
+    if (active)
+    {
+        if (activeIndex[index] == cNotActive)
+        {
+            activeIndex[index] = JPH::uint32(activeBodies.size());
+            activeBodies.push_back(id);
+        }
+    }
+    else if (activeIndex[index] != cNotActive)
+    {
+        // Swap remove, the order of the active list doesn't matter
+        JPH::uint32 position = activeIndex[index];
+        JPH::BodyID last = activeBodies.back();
+        activeBodies[position] = last;
+        activeIndex[last.GetIndex()] = position;
+        activeBodies.pop_back();
+        activeIndex[index] = cNotActive;
+
+        // Its final resting transform still has to be written once
+        settledBodies.push_back(id);
+    }
+}
+
+void BodyInstanceCache::Draw(const JPH::PhysicsSystem &system)
+{
+    SyncBodies(system);
+
+    // The listener isn't called between updates, so this lock is never contended
+    {
+        std::lock_guard<std::mutex> lock(activeMutex);
+        updateList.assign(activeBodies.begin(), activeBodies.end());
+        updateList.insert(updateList.end(), settledBodies.begin(), settledBodies.end());
+        settledBodies.clear();
+    }
+
+    // Only bodies that moved are touched, sleeping bodies keep what is already on the GPU
+    const JPH::BodyLockInterfaceNoLock &lock_interface = system.GetBodyLockInterfaceNoLock();
+    numUpdated = 0;
+    for (const JPH::BodyID &id : updateList)
+    {
+        JPH::uint32 index = id.GetIndex();
+        if (index >= slots.size() || slots[index].id != id)
+            continue; // Removed since it was activated
+
+        JPH::BodyLockRead lock(lock_interface, id);
+        if (!lock.Succeeded())
+            continue;
+        const JPH::Body &body = lock.GetBody();
+
+        // A new shape or motion type means different geometry or color, record the body again
+        if (body.GetShape() != slots[index].shape.GetPtr() || body.GetMotionType() != slots[index].motionType)
+        {
+            Unregister(index);
+            Register(body);
+        }
+        else
+            UpdateSlot(index, body.GetCenterOfMassTransform());
+        numUpdated++;
+    }
+
+    // The render origin moved, every instance has to be converted against the new one
+    if (originVersion != renderer.GetRenderOriginVersion())
+    {
+        originVersion = renderer.GetRenderOriginVersion();
+        for (JPH::uint32 index = 0; index < JPH::uint32(slots.size()); index++)
+            if (!slots[index].id.IsInvalid())
+                UpdateSlot(index, slots[index].centerOfMass);
+    }
+
+    FlushPending();
+
+    renderer.UseInstancedProgram();
+    for (Group &group : groups)
+    {
+        if (group.instances.empty())
+            continue;
+
+        Upload(group);
+
+        glBindVertexArray(group.VAO);
+        glPolygonMode(GL_FRONT_AND_BACK, group.wireframe ? GL_LINE : GL_FILL);
+        if (group.batch->uses_indices)
+            glDrawElementsInstanced(GL_TRIANGLES, GLsizei(group.batch->indices.size()), GL_UNSIGNED_INT, 0,
+                                    GLsizei(group.instances.size()));
+        else
+            glDrawArraysInstanced(GL_TRIANGLES, 0, group.batch->num_triangles * 3, GLsizei(group.instances.size()));
+    }
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    glBindVertexArray(0);
+}
+
+void BodyInstanceCache::BodyAdded(const JPH::BodyID &id)
+{
+    std::lock_guard<std::mutex> lock(changesMutex);
+    changes.emplace_back(id, true);
+}
+
+void BodyInstanceCache::BodyRemoved(const JPH::BodyID &id)
+{
+    std::lock_guard<std::mutex> lock(changesMutex);
+    changes.emplace_back(id, false);
+}
+
+void BodyInstanceCache::SyncBodies(const JPH::PhysicsSystem &system)
+{
+    {
+        std::lock_guard<std::mutex> lock(changesMutex);
+        changesCopy.swap(changes);
+    }
+
+    // In order, a body can be added and destroyed in the same frame and an added body can reuse the index of a destroyed one
+    for (const std::pair<JPH::BodyID, bool> &change : changesCopy)
+    {
+        JPH::uint32 index = change.first.GetIndex();
+        if (change.second)
+            RegisterByID(system, change.first);
+        else if (index < slots.size() && slots[index].id == change.first)
+            Unregister(index);
+    }
+    changesCopy.clear();
+
+    for (const JPH::BodyID &id : staleBodies)
+        if (id.GetIndex() < slots.size() && slots[id.GetIndex()].id == id)
+        {
+            Unregister(id.GetIndex());
+            RegisterByID(system, id);
+        }
+    staleBodies.clear();
+
+    // Bodies added or removed without telling us show up in the count, find them by walking all bodies
+    if (needsRefresh || system.GetNumBodies() != numRegistered)
+        Rescan(system);
+}
+
+void BodyInstanceCache::RegisterByID(const JPH::PhysicsSystem &system, const JPH::BodyID &id)
+{
+    JPH::uint32 index = id.GetIndex();
+    if (index < slots.size() && slots[index].id == id)
+        return; // already registered
+    if (index >= slots.size())
+        slots.resize(index + 1);
+    else if (!slots[index].id.IsInvalid())
+        Unregister(index); // removed without BodyRemoved, its index was reused
+
+    JPH::BodyLockRead lock(system.GetBodyLockInterfaceNoLock(), id);
+    if (lock.Succeeded())
+        Register(lock.GetBody());
+}
+
+void BodyInstanceCache::Rescan(const JPH::PhysicsSystem &system)
+{
+    if (needsRefresh)
+    {
+        for (JPH::uint32 index = 0; index < JPH::uint32(slots.size()); index++)
+            if (!slots[index].id.IsInvalid())
+                Unregister(index);
+        needsRefresh = false;
+    }
+
+    for (BodySlot &slot : slots)
+        slot.seen = false;
+
+    system.GetBodies(allBodies);
+    for (const JPH::BodyID &id : allBodies)
+    {
+        RegisterByID(system, id);
+        if (id.GetIndex() < slots.size())
+            slots[id.GetIndex()].seen = true;
+    }
+
+    for (JPH::uint32 index = 0; index < slots.size(); index++)
+        if (!slots[index].id.IsInvalid() && !slots[index].seen)
+            Unregister(index);
+}
+
+void BodyInstanceCache::Register(const JPH::Body &body)
+{
+    JPH::Color color = body_draw_color(body);
+
+    // Let the shape tell us which geometry it draws with and where
+    JPH::RMat44 com = body.GetCenterOfMassTransform();
+    recorded.clear();
+    renderer.BeginRecording(&recorded);
+    body.GetShape()->Draw(&renderer, com, JPH::Vec3::sReplicate(1.0f), color, false, false);
+    renderer.EndRecording();
+
+    JPH::uint32 index = body.GetID().GetIndex();
+    BodySlot &slot = slots[index];
+    slot.id = body.GetID();
+    slot.parts.clear();
+    slot.shape = body.GetShape();
+    slot.motionType = body.GetMotionType();
+    numRegistered++;
+
+    JPH::RMat44 inverse_com = com.InversedRotationTranslation();
+    for (const PhysicsDebugRenderer::RecordedGeometry &record : recorded)
+    {
+        JPH::uint32 group_index = FindOrCreateGroup(record.geometry, record.drawMode == JPH::DebugRenderer::EDrawMode::Wireframe);
+        Group &group = groups[group_index];
+
+        Part part;
+        part.group = group_index;
+        part.instance = JPH::uint32(group.instances.size());
+#ifdef JPH_DOUBLE_PRECISION
+        part.localTransform = (inverse_com * record.modelMatrix).ToMat44();
+#else
+        part.localTransform = inverse_com * record.modelMatrix;
+#endif
+
+        group.instances.emplace_back();
+        group.owners.emplace_back(index, JPH::uint32(slot.parts.size()));
+
+        InstanceData &instance = group.instances.back();
+        instance.color[0] = record.color.r / 255.0f;
+        instance.color[1] = record.color.g / 255.0f;
+        instance.color[2] = record.color.b / 255.0f;
+
+        slot.parts.push_back(part);
+    }
+    UpdateSlot(index, com);
+
+    // Bodies that were already active before we saw them never got an activation event
+    if (body.IsActive())
+        MarkActive(body.GetID(), true);
+}
+
+void BodyInstanceCache::Unregister(JPH::uint32 index)
+{
+    BodySlot &slot = slots[index];
+    for (size_t p = 0; p < slot.parts.size(); p++)
+    {
+        const Part &part = slot.parts[p];
+        Group &group = groups[part.group];
+
+        // Swap remove, the moved instance tells its owner where it went
+        JPH::uint32 last = JPH::uint32(group.instances.size() - 1);
+        if (part.instance != last)
+        {
+            group.instances[part.instance] = group.instances[last];
+            group.owners[part.instance] = group.owners[last];
+            const std::pair<JPH::uint32, JPH::uint32> &owner = group.owners[part.instance];
+            slots[owner.first].parts[owner.second].instance = part.instance;
+            group.dirty.push_back(part.instance);
+        }
+        group.instances.pop_back();
+        group.owners.pop_back();
+    }
+
+    JPH::BodyID old_id = slot.id;
+    slot.parts.clear();
+    slot.shape = nullptr;
+    slot.id = JPH::BodyID();
+    numRegistered--;
+    MarkActive(old_id, false);
+}
+
+void BodyInstanceCache::UpdateSlot(JPH::uint32 index, JPH::RMat44Arg centerOfMassTransform)
+{
+    BodySlot &slot = slots[index];
+    slot.centerOfMass = centerOfMassTransform;
+    for (JPH::uint32 p = 0; p < JPH::uint32(slot.parts.size()); p++)
+    {
+        pendingMatrices.push_back(centerOfMassTransform * slot.parts[p].localTransform);
+        pendingParts.emplace_back(index, p);
+    }
+}
+
+void BodyInstanceCache::FlushPending()
+{
+    // Parts are resolved only now, registering and unregistering may have moved instances around
+    pendingOut.resize(pendingParts.size());
+    for (size_t i = 0; i < pendingParts.size(); i++)
+    {
+        const Part &part = slots[pendingParts[i].first].parts[pendingParts[i].second];
+        Group &group = groups[part.group];
+        pendingOut[i] = group.instances[part.instance].localToWorld;
+        group.dirty.push_back(part.instance);
+    }
+
+    convert_to_render_space(pendingMatrices.data(), pendingOut.data(), pendingMatrices.size(), renderer.GetRenderOrigin());
+
+    pendingMatrices.clear();
+    pendingParts.clear();
+}
+
+JPH::uint32 BodyInstanceCache::FindOrCreateGroup(const JPH::DebugRenderer::GeometryRef &geometry, bool wireframe)
+{
+    // use lod 0 like DrawGeometry does
+    TriangleData *batch = static_cast<TriangleData *>(geometry->mLODs[0].mTriangleBatch.GetPtr());
+
+    std::pair<const TriangleData *, bool> key(batch, wireframe);
+    auto it = groupLookup.find(key);
+    if (it != groupLookup.end())
+        return it->second;
+
+    JPH::uint32 group_index = JPH::uint32(groups.size());
+    groups.emplace_back();
+    Group &group = groups.back();
+    group.geometry = geometry;
+    group.batch = batch;
+    group.wireframe = wireframe;
+
+    glGenVertexArrays(1, &group.VAO);
+    glGenBuffers(1, &group.instanceVBO);
+
+    glBindVertexArray(group.VAO);
+    batch->BindBuffers();
+
+    // mat4 takes 4 attribute slots, one per column
+    glBindBuffer(GL_ARRAY_BUFFER, group.instanceVBO);
+    for (int col = 0; col < 4; col++)
+    {
+        glVertexAttribPointer(2 + col, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                              (void *)(offsetof(InstanceData, localToWorld) + col * 4 * sizeof(float)));
+        glEnableVertexAttribArray(2 + col);
+        glVertexAttribDivisor(2 + col, 1);
+    }
+    glVertexAttribPointer(6, 3, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void *)offsetof(InstanceData, color));
+    glEnableVertexAttribArray(6);
+    glVertexAttribDivisor(6, 1);
+    glBindVertexArray(0);
+
+    groupLookup[key] = group_index;
+    return group_index;
+}
+
+void BodyInstanceCache::Upload(Group &group)
+{
+    glBindBuffer(GL_ARRAY_BUFFER, group.instanceVBO);
+
+    if (group.instances.size() > group.gpuCapacity)
+    {
+        // Grow geometrically and send everything, the VAO keeps pointing at the same buffer name
+        group.gpuCapacity = std::max<size_t>(group.instances.size(), group.gpuCapacity * 2);
+        glBufferData(GL_ARRAY_BUFFER, group.gpuCapacity * sizeof(InstanceData), nullptr, GL_DYNAMIC_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, group.instances.size() * sizeof(InstanceData), group.instances.data());
+        group.dirty.clear();
+        return;
+    }
+
+    // Send the changed instances as runs, so the upload scales with the number of moving bodies and not with
+    // how far apart they are in the group. Runs a few clean instances apart are merged, one slightly larger
+    // copy is cheaper than another call.
+    constexpr JPH::uint32 cMergeGap = 8;
+    std::sort(group.dirty.begin(), group.dirty.end());
+    JPH::uint32 num_instances = JPH::uint32(group.instances.size());
+    size_t i = 0;
+    while (i < group.dirty.size() && group.dirty[i] < num_instances) // instances past the end were removed
+    {
+        JPH::uint32 begin = group.dirty[i], end = begin + 1;
+        while (++i < group.dirty.size() && group.dirty[i] < num_instances && group.dirty[i] <= end + cMergeGap)
+            end = std::max(end, group.dirty[i] + 1);
+        glBufferSubData(GL_ARRAY_BUFFER, begin * sizeof(InstanceData), (end - begin) * sizeof(InstanceData),
+                        &group.instances[begin]);
+    }
+    group.dirty.clear();
+}
@@ -0,0 +1,139 @@
+#ifndef BODY_INSTANCE_CACHE_HPP
+#define BODY_INSTANCE_CACHE_HPP
+
+#include <Jolt/Jolt.h>
+#include <Jolt/Physics/PhysicsSystem.h>
+#include <Jolt/Physics/Body/BodyActivationListener.h>
+#include <Jolt/Physics/Body/MotionType.h>
+#include <Jolt/Physics/Collision/Shape/Shape.h>
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include "physics_debug_renderer.hpp"
+
+// Draws all bodies of a PhysicsSystem from persistent per-body instance slots kept in GPU buffers.
+//
+// PhysicsSystem::DrawBodies converts and uploads every body every frame. Here each body records
+// its geometry once, bodies sharing a geometry are drawn with one instanced call, and only the
+// slots of active bodies (plus bodies that just went to sleep) are rewritten. Which bodies are
+// active is tracked through BodyActivationListener events, so register this as the activation
+// listener of the system (other listeners can be chained with SetForwardListener).
+//
+// Report added and removed bodies with BodyAdded / BodyRemoved, Draw then only touches those. As a
+// fallback Draw compares PhysicsSystem::GetNumBodies (a counter, O(1)) with the number of registered
+// bodies and rescans all bodies of the system when they differ, which walks every body. The fallback
+// can't see a body removed and another added in the same frame, only the hooks catch that.
+class BodyInstanceCache final : public JPH::BodyActivationListener {
+
+public:
+  explicit BodyInstanceCache(PhysicsDebugRenderer &renderer);
+  ~BodyInstanceCache() override;
+
+  // Activation events are passed on to this listener after being tracked
+  void SetForwardListener(JPH::BodyActivationListener *listener) { forward = listener; }
+
+  // See: BodyActivationListener, called from physics jobs
+  void OnBodyActivated(const JPH::BodyID &inBodyID, JPH::uint64 inBodyUserData) override;
+  void OnBodyDeactivated(const JPH::BodyID &inBodyID, JPH::uint64 inBodyUserData) override;
+
+  // Thread safe, call after BodyInterface::CreateBody and DestroyBody. Like PhysicsSystem::DrawBodies, every body
+  // that exists is drawn, whether or not it was added to the system.
+  void BodyAdded(const JPH::BodyID &id);
+  void BodyRemoved(const JPH::BodyID &id);
+
+  // Records the geometry and color of a body again in the next Draw. Shape and motion type changes of
+  // moving bodies are detected, call this after SetShape on a sleeping body (without activating it).
+  void Invalidate(const JPH::BodyID &id) { staleBodies.push_back(id); }
+  // Same for every body, rescans all bodies of the system
+  void Invalidate() { needsRefresh = true; }
+
+  // Updates the slots of the bodies that moved and draws every body, call between PhysicsSystem::Update calls
+  void Draw(const JPH::PhysicsSystem &system);
+
+  unsigned int NumBodies() const { return numRegistered; }
+  unsigned int NumUpdatedLastDraw() const { return numUpdated; }
+
+private:
+  struct InstanceData {
+    float localToWorld[16];
+    float color[3];
+  };
+
+  // All instances drawing the same geometry in the same mode, one instanced draw call
+  struct Group {
+    JPH::DebugRenderer::GeometryRef geometry;
+    TriangleData *batch = nullptr;
+    bool wireframe = false;
+    unsigned int VAO = 0, instanceVBO = 0;
+    size_t gpuCapacity = 0;
+    std::vector<InstanceData> instances;
+    std::vector<std::pair<JPH::uint32, JPH::uint32>> owners; // (body index, part index) of every instance
+    std::vector<JPH::uint32> dirty; // instances changed since the last upload, unsorted and with duplicates
+  };
+
+  // One DrawGeometry call of a body, relative to its center of mass
+  struct Part {
+    JPH::uint32 group;
+    JPH::uint32 instance;
+    JPH::Mat44 localTransform;
+  };
+
+  struct BodySlot {
+    JPH::BodyID id;
+    JPH::RMat44 centerOfMass; // last uploaded, needed again when the render origin moves
+    std::vector<Part> parts;
+    JPH::RefConst<JPH::Shape> shape; // what the parts were recorded from, kept alive so the pointer can't be reused
+    JPH::EMotionType motionType = JPH::EMotionType::Static; // decides the color
+    bool seen = false;
+  };
+
+  static constexpr JPH::uint32 cNotActive = ~JPH::uint32(0);
+
+  // Registers added bodies and unregisters removed and invalidated ones
+  void SyncBodies(const JPH::PhysicsSystem &system);
+  void RegisterByID(const JPH::PhysicsSystem &system, const JPH::BodyID &id);
+  void Rescan(const JPH::PhysicsSystem &system);
+  void Register(const JPH::Body &body);
+  void Unregister(JPH::uint32 index);
+  // Queues the parts of a body for conversion, FlushPending converts everything queued in one batch
+  void UpdateSlot(JPH::uint32 index, JPH::RMat44Arg centerOfMassTransform);
+  void FlushPending();
+  void MarkActive(const JPH::BodyID &id, bool active);
+  JPH::uint32 FindOrCreateGroup(const JPH::DebugRenderer::GeometryRef &geometry, bool wireframe);
+  void Upload(Group &group);
+
+  PhysicsDebugRenderer &renderer;
+  JPH::BodyActivationListener *forward = nullptr;
+
+  std::vector<BodySlot> slots; // indexed by BodyID::GetIndex()
+  std::vector<Group> groups;
+  std::map<std::pair<const TriangleData *, bool>, JPH::uint32> groupLookup;
+  std::vector<PhysicsDebugRenderer::RecordedGeometry> recorded;
+
+  // Written from physics jobs through the activation listener
+  std::mutex activeMutex;
+  std::vector<JPH::BodyID> activeBodies;
+  std::vector<JPH::uint32> activeIndex; // position in activeBodies by body index, or cNotActive
+  std::vector<JPH::BodyID> settledBodies; // went to sleep since the last Draw, need one last update
+
+  std::vector<JPH::RMat44> pendingMatrices;
+  std::vector<std::pair<JPH::uint32, JPH::uint32>> pendingParts; // (body index, part index)
+  std::vector<float *> pendingOut;
+  unsigned int originVersion = 0;
+
+  std::vector<JPH::BodyID> updateList;
+  JPH::BodyIDVector allBodies;
+  std::vector<JPH::BodyID> staleBodies;
+  bool needsRefresh = true; // the first Draw picks up the bodies that are already there
+
+  // Written by BodyAdded / BodyRemoved from any thread
+  std::mutex changesMutex;
+  std::vector<std::pair<JPH::BodyID, bool>> changes, changesCopy; // (body, added), in the order they happened
+  unsigned int numRegistered = 0;
+  unsigned int numUpdated = 0;
+};
+
+#endif // BODY_INSTANCE_CACHE_HPP
@@ -0,0 +1,177 @@
+#include "draw_command_queue.hpp"
+#include "physics_debug_renderer.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+thread_local DrawCommandQueue::ThreadCache DrawCommandQueue::threadCache;
+
+static std::atomic<unsigned int> next_queue_id{1};
+
+DrawCommandQueue::DrawCommandQueue() : id(next_queue_id++)
+{
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &instanceVBO);
+
+    // The instance attributes are enabled once, Submit points them at the instances of every run
+    glBindVertexArray(VAO);
+    for (int col = 0; col < 4; col++)
+    {
+        glEnableVertexAttribArray(2 + col);
+        glVertexAttribDivisor(2 + col, 1);
+    }
+    glEnableVertexAttribArray(6);
+    glVertexAttribDivisor(6, 1);
+    glBindVertexArray(0);
+}
+
+DrawCommandQueue::~DrawCommandQueue()
+{
+    if (!gl_context_is_alive())
+        return;
+
+    glDeleteBuffers(1, &instanceVBO);
+    glDeleteVertexArrays(1, &VAO);
+}
+
+DrawCommandQueue::CommandList &DrawCommandQueue::GetThreadList()
+{
+    if (threadCache.queueId == id)
+        return *threadCache.list;
+
+    // First time this thread records into this queue (or it recorded into another queue in between)
+    std::thread::id self = std::this_thread::get_id();
+    std::lock_guard<std::mutex> lock(listsMutex);
+    CommandList *list = nullptr;
+    for (const std::unique_ptr<CommandList> &candidate : lists)
+        if (candidate->owner == self)
+            list = candidate.get();
+    if (list == nullptr)
+    {
+        lists.push_back(std::make_unique<CommandList>());
+        list = lists.back().get();
+        list->owner = self;
+    }
+
+    threadCache.queueId = id;
+    threadCache.list = list;
+    return *list;
+}
+
+void DrawCommandQueue::Record(TriangleData *batch, bool wireframe, const float *localToWorld, JPH::ColorArg color)
+{
+    CommandList &list = GetThreadList();
+    list.commands.emplace_back();
+    Command &command = list.commands.back();
+    command.batch = batch;
+    command.wireframe = wireframe;
+    memcpy(command.instance.localToWorld, localToWorld, sizeof(command.instance.localToWorld));
+    command.instance.color[0] = color.r / 255.0f;
+    command.instance.color[1] = color.g / 255.0f;
+    command.instance.color[2] = color.b / 255.0f;
+}
+
+void DrawCommandQueue::Submit()
+{
+    numCommands = 0;
+    numDrawCalls = 0;
+    runs.clear();
+    runLookup.clear();
+    commandRun.clear();
+
+    // Find the run of every command. Commands come in streaks of the same geometry (all boxes of a
+    // chunk of bodies), so only look up the key when it changes.
+    for (const std::unique_ptr<CommandList> &list : lists)
+    {
+        uintptr_t last_key = UINTPTR_MAX;
+        JPH::uint32 last_run = 0;
+        for (const Command &command : list->commands)
+        {
+            // Pointers are aligned, the low bit is free for the fill mode
+            uintptr_t key = reinterpret_cast<uintptr_t>(command.batch) | uintptr_t(command.wireframe);
+            if (key != last_key)
+            {
+                auto it = runLookup.find(key);
+                if (it == runLookup.end())
+                {
+                    it = runLookup.emplace(key, JPH::uint32(runs.size())).first;
+                    runs.push_back({command.batch, command.wireframe, 0, 0});
+                }
+                last_key = key;
+                last_run = it->second;
+            }
+            runs[last_run].count++;
+            commandRun.push_back(last_run);
+        }
+        numCommands += list->commands.size();
+    }
+
+    if (numCommands == 0)
+        return;
+
+    // Filled before wireframe so the polygon mode changes once, then by geometry
+    std::vector<JPH::uint32> order(runs.size());
+    for (JPH::uint32 i = 0; i < JPH::uint32(runs.size()); i++)
+        order[i] = i;
+    std::sort(order.begin(), order.end(), [this](JPH::uint32 a, JPH::uint32 b) {
+        if (runs[a].wireframe != runs[b].wireframe)
+            return !runs[a].wireframe;
+        return runs[a].batch < runs[b].batch;
+    });
+    size_t offset = 0;
+    for (JPH::uint32 i : order)
+    {
+        runs[i].offset = offset;
+        offset += runs[i].count;
+    }
+
+    // Scatter the instances into their runs, count is reused as the fill cursor
+    instances.resize(numCommands);
+    for (Run &run : runs)
+        run.count = 0;
+    size_t command_index = 0;
+    for (const std::unique_ptr<CommandList> &list : lists)
+    {
+        for (const Command &command : list->commands)
+        {
+            Run &run = runs[commandRun[command_index++]];
+            instances[run.offset + run.count++] = command.instance;
+        }
+        list->commands.clear();
+    }
+
+    // One upload for everything, orphaning the old storage so we don't wait for the previous frame
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    if (numCommands > gpuCapacity)
+        gpuCapacity = std::max(numCommands, gpuCapacity * 2);
+    glBufferData(GL_ARRAY_BUFFER, gpuCapacity * sizeof(Instance), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, numCommands * sizeof(Instance), instances.data());
+
+    glBindVertexArray(VAO);
+    for (JPH::uint32 i : order)
+    {
+        const Run &run = runs[i];
+        run.batch->BindBuffers();
+
+        // No base instance in GL 3.3, point the instance attributes at the start of the run instead
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        size_t base = run.offset * sizeof(Instance);
+        for (int col = 0; col < 4; col++)
+            glVertexAttribPointer(2 + col, 4, GL_FLOAT, GL_FALSE, sizeof(Instance),
+                                  (void *)(base + offsetof(Instance, localToWorld) + col * 4 * sizeof(float)));
+        glVertexAttribPointer(6, 3, GL_FLOAT, GL_FALSE, sizeof(Instance), (void *)(base + offsetof(Instance, color)));
+
+        glPolygonMode(GL_FRONT_AND_BACK, run.wireframe ? GL_LINE : GL_FILL);
+        if (run.batch->uses_indices)
+            glDrawElementsInstanced(GL_TRIANGLES, GLsizei(run.batch->indices.size()), GL_UNSIGNED_INT, 0,
+                                    GLsizei(run.count));
+        else
+            glDrawArraysInstanced(GL_TRIANGLES, 0, run.batch->num_triangles * 3, GLsizei(run.count));
+        numDrawCalls++;
+    }
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    glBindVertexArray(0);
+}
@@ -0,0 +1,92 @@
+#ifndef DRAW_COMMAND_QUEUE_HPP
+#define DRAW_COMMAND_QUEUE_HPP
+
+#include <Jolt/Jolt.h>
+#include <Jolt/Core/Color.h>
+
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+class TriangleData;
+
+// Collects draw commands from any number of threads and draws them from the GL thread.
+//
+// Every thread that records gets its own command list, found through a thread_local pointer, so
+// recording never takes a lock or touches memory another thread writes (the mutex is only taken the
+// first time a thread records). Submit merges all lists and groups the commands by geometry and fill
+// mode: a hash map gives every group an index and counts its commands, std::sort orders the groups
+// (filled first, then by geometry) and the instances are scattered into their group's slice. It then
+// uploads all instances in one go and issues one instanced draw per group.
+class DrawCommandQueue {
+
+public:
+  // Needs a current GL context
+  DrawCommandQueue();
+  ~DrawCommandQueue();
+
+  DrawCommandQueue(const DrawCommandQueue &) = delete;
+  DrawCommandQueue &operator=(const DrawCommandQueue &) = delete;
+
+  // Thread safe. localToWorld is a column major 4x4 matrix in render space (see convert_to_render_space).
+  // The geometry must stay alive until Submit, which it does as long as the shape drawing it does.
+  void Record(TriangleData *batch, bool wireframe, const float *localToWorld, JPH::ColorArg color);
+
+  // Draws and clears everything recorded since the last Submit with the bound instanced program.
+  // Call from the GL thread once no other thread is recording anymore (e.g. after waiting for the jobs).
+  void Submit();
+
+  size_t NumCommandsLastSubmit() const { return numCommands; }
+  size_t NumDrawCallsLastSubmit() const { return numDrawCalls; }
+
+private:
+  struct Instance {
+    float localToWorld[16];
+    float color[3];
+  };
+
+  struct Command {
+    TriangleData *batch;
+    bool wireframe;
+    Instance instance;
+  };
+
+  struct CommandList {
+    std::thread::id owner;
+    std::vector<Command> commands;
+  };
+
+  // All commands with the same geometry and fill mode, drawn with one call
+  struct Run {
+    TriangleData *batch;
+    bool wireframe;
+    size_t offset;
+    size_t count;
+  };
+
+  struct ThreadCache {
+    unsigned int queueId = 0;
+    CommandList *list = nullptr;
+  };
+
+  CommandList &GetThreadList();
+
+  static thread_local ThreadCache threadCache;
+
+  unsigned int id; // unique for every queue ever created, so a cached list is never mistaken for one of a dead queue
+  std::mutex listsMutex;
+  std::vector<std::unique_ptr<CommandList>> lists;
+
+  unsigned int VAO = 0, instanceVBO = 0;
+  size_t gpuCapacity = 0;
+  std::vector<Run> runs;
+  std::unordered_map<uintptr_t, JPH::uint32> runLookup;
+  std::vector<JPH::uint32> commandRun;
+  std::vector<Instance> instances;
+  size_t numCommands = 0;
+  size_t numDrawCalls = 0;
+};
+
+#endif // DRAW_COMMAND_QUEUE_HPP
@@ -0,0 +1,183 @@
+#include "frame_capture.hpp"
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#endif
+
+FrameCapture::FrameCapture(const std::string &target, CaptureFormat format, unsigned int width, unsigned int height,
+                           unsigned int ringSize)
+    : format(format), width(width), height(height), ring(ringSize < 2 ? 2 : ringSize)
+{
+    if (!target.empty() && target[0] == '|')
+    {
+        stream = popen(target.c_str() + 1, "w");
+        isPipe = true;
+    }
+    else if (target.find('%') != std::string::npos)
+    {
+        if (IsValidPattern(target))
+            filePattern = target;
+    }
+    else
+    {
+        stream = fopen(target.c_str(), "wb");
+    }
+
+    if (!IsOpen())
+    {
+        fprintf(stderr, "Error: couldn't open capture target '%s'\n", target.c_str());
+        return;
+    }
+
+    rowBuffer.resize(width * 3);
+
+    // GL_RGBA/GL_UNSIGNED_BYTE is the layout drivers can copy without conversion, we drop alpha when writing
+    for (Slot &slot : ring)
+    {
+        glGenBuffers(1, &slot.pbo);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+        glBufferData(GL_PIXEL_PACK_BUFFER, width * height * 4, nullptr, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+bool FrameCapture::IsValidPattern(const std::string &pattern)
+{
+    int conversions = 0;
+    for (size_t i = 0; i < pattern.size(); i++)
+    {
+        if (pattern[i] != '%')
+            continue;
+        if (++i < pattern.size() && pattern[i] == '%')
+            continue;
+        while (i < pattern.size() && pattern[i] >= '0' && pattern[i] <= '9')
+            i++;
+        if (i == pattern.size() || pattern[i] != 'd')
+            return false;
+        conversions++;
+    }
+    return conversions == 1;
+}
+
+FrameCapture::~FrameCapture()
+{
+    for (Slot &slot : ring)
+    {
+        if (slot.fence != nullptr)
+            glDeleteSync(slot.fence);
+        if (slot.pbo != 0)
+            glDeleteBuffers(1, &slot.pbo);
+    }
+
+    if (stream != nullptr)
+    {
+        if (isPipe)
+            pclose(stream);
+        else
+            fclose(stream);
+    }
+}
+
+void FrameCapture::Capture()
+{
+    if (!IsOpen())
+        return;
+
+    // The slot we are about to reuse holds the frame from ringSize frames ago, drain it first
+    Slot &slot = ring[next];
+    if (slot.fence != nullptr)
+        WriteSlot(slot);
+
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.frame = framesQueued++;
+
+    next = (next + 1) % ring.size();
+}
+
+void FrameCapture::Finish()
+{
+    if (!IsOpen())
+        return;
+
+    // Oldest first so the frames come out in order
+    for (size_t i = 0; i < ring.size(); i++)
+    {
+        Slot &slot = ring[(next + i) % ring.size()];
+        if (slot.fence != nullptr)
+            WriteSlot(slot);
+    }
+
+    if (stream != nullptr)
+        fflush(stream);
+}
+
+void FrameCapture::WriteSlot(Slot &slot)
+{
+    // Only blocks if the GPU is a whole ring behind, in that case we'd have to wait anyway. A fence that doesn't
+    // signal within a second won't (e.g. the context was lost), drop the frame instead of hanging.
+    const GLuint64 cTimeoutNs = 1000000000;
+    GLenum wait = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, cTimeoutNs);
+    glDeleteSync(slot.fence);
+    slot.fence = nullptr;
+    if (wait == GL_TIMEOUT_EXPIRED || wait == GL_WAIT_FAILED)
+    {
+        fprintf(stderr, "Error: capture of frame %u dropped, %s\n", slot.frame,
+                wait == GL_TIMEOUT_EXPIRED ? "the GPU didn't finish it in time" : "waiting for it failed");
+        framesDropped++;
+        return;
+    }
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    const unsigned char *pixels =
+        static_cast<const unsigned char *>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, width * height * 4, GL_MAP_READ_BIT));
+    if (pixels != nullptr)
+    {
+        WriteFrame(pixels, slot.frame);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void FrameCapture::WriteFrame(const unsigned char *rgba, unsigned int frame)
+{
+    FILE *out = stream;
+    if (!filePattern.empty())
+    {
+        char path[1024];
+        snprintf(path, sizeof(path), filePattern.c_str(), int(frame)); // checked by IsValidPattern
+        out = fopen(path, "wb");
+        if (out == nullptr)
+        {
+            fprintf(stderr, "Error: couldn't open capture file '%s'\n", path);
+            return;
+        }
+    }
+
+    if (format == CaptureFormat::PPM)
+        fprintf(out, "P6\n%u %u\n255\n", width, height);
+
+    // GL rows start at the bottom, image formats start at the top
+    for (unsigned int y = 0; y < height; y++)
+    {
+        const unsigned char *src = rgba + (height - 1 - y) * width * 4;
+        unsigned char *dst = rowBuffer.data();
+        for (unsigned int x = 0; x < width; x++, src += 4, dst += 3)
+        {
+            dst[0] = src[0];
+            dst[1] = src[1];
+            dst[2] = src[2];
+        }
+        fwrite(rowBuffer.data(), 1, rowBuffer.size(), out);
+    }
+
+    if (out != stream)
+        fclose(out);
+
+    framesWritten++;
+}
@@ -0,0 +1,69 @@
+#ifndef FRAME_CAPTURE_HPP
+#define FRAME_CAPTURE_HPP
+
+#include <glad/glad.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+enum class CaptureFormat {
+  PPM, // binary P6 frames, one file per frame or concatenated into a stream/pipe
+  Raw, // tightly packed RGB24, top row first (ffmpeg -f rawvideo -pix_fmt rgb24)
+};
+
+// Reads back the currently bound read framebuffer through a ring of pixel-buffer objects.
+// glReadPixels into a PBO returns immediately, the buffer is mapped only once it has
+// cycled through the whole ring, so the CPU never waits for the frame it just submitted.
+//
+// target can be:
+//   "|ffmpeg ..."       write a stream into the stdin of the given command
+//   "frame_%05d.ppm"    one file per frame, exactly one %d conversion (with an optional width) for the frame number
+//                       and %% for a literal percent sign, see IsValidPattern
+//   anything else       a single file all frames are appended to
+class FrameCapture {
+
+public:
+  FrameCapture(const std::string &target, CaptureFormat format, unsigned int width, unsigned int height,
+               unsigned int ringSize = 3);
+  ~FrameCapture();
+
+  // Queues a readback of the current frame and writes out the oldest frame still in flight
+  void Capture();
+
+  // Writes out all frames still in flight, call before the GL context goes away
+  void Finish();
+
+  bool IsOpen() const { return stream != nullptr || !filePattern.empty(); }
+  unsigned int FramesDropped() const { return framesDropped; }
+
+  // The pattern is used as a printf format, anything but one %[0-9]*d and %% would be undefined behavior
+  static bool IsValidPattern(const std::string &pattern);
+  unsigned int FramesWritten() const { return framesWritten; }
+
+private:
+  struct Slot {
+    unsigned int pbo = 0;
+    GLsync fence = nullptr;
+    unsigned int frame = 0;
+  };
+
+  void WriteSlot(Slot &slot);
+  void WriteFrame(const unsigned char *rgba, unsigned int frame);
+
+  CaptureFormat format;
+  unsigned int width;
+  unsigned int height;
+  std::vector<Slot> ring;
+  unsigned int next = 0;
+  unsigned int framesQueued = 0;
+  unsigned int framesWritten = 0;
+  unsigned int framesDropped = 0;
+
+  std::string filePattern;
+  FILE *stream = nullptr;
+  bool isPipe = false;
+  std::vector<unsigned char> rowBuffer;
+};
+
+#endif // FRAME_CAPTURE_HPP
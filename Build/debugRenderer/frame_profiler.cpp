@@ -0,0 +1,241 @@
+#include "frame_profiler.hpp"
+#include "physics_debug_renderer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+static float ms_between(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+{
+    return std::chrono::duration<float, std::milli>(end - start).count();
+}
+
+FrameProfiler::FrameProfiler(unsigned int historySize, unsigned int queryRingSize)
+    : historySize(std::max(1u, historySize)), queries(std::max(2u, queryRingSize))
+{
+    for (QuerySlot &slot : queries)
+        glGenQueries(1, &slot.query);
+}
+
+FrameProfiler::~FrameProfiler()
+{
+    if (csv != nullptr)
+    {
+        WriteCsvRows(true);
+        fclose(csv);
+    }
+
+    if (!gl_context_is_alive())
+        return;
+
+    if (activeQuery != nullptr)
+        glEndQuery(GL_TIME_ELAPSED);
+    for (QuerySlot &slot : queries)
+        glDeleteQueries(1, &slot.query);
+}
+
+const char *FrameProfiler::GetName(FrameSection section)
+{
+    switch (section)
+    {
+    case FrameSection::Frame:
+        return "frame";
+    case FrameSection::Update:
+        return "update";
+    case FrameSection::Draw:
+        return "draw";
+    case FrameSection::Swap:
+        return "swap";
+    case FrameSection::Gpu:
+        return "gpu";
+    default:
+        return "?";
+    }
+}
+
+void FrameProfiler::AddSample(FrameSection section, float ms)
+{
+    std::vector<float> &samples = history[int(section)];
+    unsigned int &next = historyNext[int(section)];
+    if (samples.size() < historySize)
+        samples.push_back(ms);
+    else
+        samples[next] = ms;
+    next = (next + 1) % historySize;
+}
+
+void FrameProfiler::BeginFrame()
+{
+    Clock::time_point now = Clock::now();
+
+    if (activeQuery != nullptr)
+        EndGpu();
+
+    // Close the previous frame, sections that weren't timed in it don't get a sample
+    if (frame > 0)
+    {
+        frameMs[int(FrameSection::Frame)] = ms_between(frameStart, now);
+        timed[int(FrameSection::Frame)] = true;
+        for (int i = 0; i < cNumSections; i++)
+            if (timed[i] && i != int(FrameSection::Gpu))
+                AddSample(FrameSection(i), frameMs[i]);
+
+        if (csv != nullptr)
+        {
+            CsvRow row;
+            row.frame = frame;
+            for (int i = 0; i < cNumSections; i++)
+                row.ms[i] = timed[i] ? frameMs[i] : -1.0f;
+            row.gpuKnown = !gpuIssued;
+            csvRows.push_back(row);
+        }
+    }
+
+    CollectQueries();
+    WriteCsvRows(false);
+
+    frame++;
+    frameStart = now;
+    std::fill(std::begin(frameMs), std::end(frameMs), 0.0f);
+    std::fill(std::begin(timed), std::end(timed), false);
+
+    // Reuse the oldest query only once its result has been read, otherwise skip GPU timing for this frame
+    QuerySlot &slot = queries[nextQuery];
+    gpuIssued = !slot.pending;
+    if (gpuIssued)
+    {
+        glBeginQuery(GL_TIME_ELAPSED, slot.query);
+        slot.frame = frame;
+        slot.pending = true;
+        activeQuery = &slot;
+        nextQuery = (nextQuery + 1) % queries.size();
+    }
+}
+
+void FrameProfiler::EndGpu()
+{
+    if (activeQuery == nullptr)
+        return;
+    glEndQuery(GL_TIME_ELAPSED);
+    activeQuery = nullptr;
+}
+
+void FrameProfiler::CollectQueries()
+{
+    // Oldest first, the results come in in the order the queries were issued
+    for (size_t i = 0; i < queries.size(); i++)
+    {
+        QuerySlot &slot = queries[(nextQuery + i) % queries.size()];
+        if (!slot.pending || &slot == activeQuery)
+            continue;
+
+        GLint available = 0;
+        glGetQueryObjectiv(slot.query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            break;
+
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(slot.query, GL_QUERY_RESULT, &nanoseconds);
+        slot.pending = false;
+
+        float ms = float(nanoseconds * 1.0e-6);
+        AddSample(FrameSection::Gpu, ms);
+        for (CsvRow &row : csvRows)
+            if (row.frame == slot.frame)
+            {
+                row.ms[int(FrameSection::Gpu)] = ms;
+                row.gpuKnown = true;
+            }
+    }
+}
+
+void FrameProfiler::BeginCpu(FrameSection section)
+{
+    sectionStart[int(section)] = Clock::now();
+}
+
+void FrameProfiler::EndCpu(FrameSection section)
+{
+    frameMs[int(section)] += ms_between(sectionStart[int(section)], Clock::now());
+    timed[int(section)] = true;
+}
+
+SectionStats FrameProfiler::GetStats(FrameSection section) const
+{
+    SectionStats stats;
+    const std::vector<float> &samples = history[int(section)];
+    if (samples.empty())
+        return stats;
+
+    std::vector<float> sorted = samples;
+    size_t p99 = size_t(std::ceil(0.99 * sorted.size())) - 1;
+    std::nth_element(sorted.begin(), sorted.begin() + p99, sorted.end());
+
+    double sum = 0.0;
+    for (float ms : samples)
+        sum += ms;
+
+    stats.minMs = *std::min_element(samples.begin(), samples.end());
+    stats.avgMs = float(sum / samples.size());
+    stats.p99Ms = sorted[p99];
+    stats.samples = (unsigned int)samples.size();
+    return stats;
+}
+
+std::string FrameProfiler::FormatStats() const
+{
+    std::string text;
+    char line[96];
+    snprintf(line, sizeof(line), "%-7s %7s %7s %7s\n", "ms", "min", "avg", "p99");
+    text += line;
+    for (int i = 0; i < cNumSections; i++)
+    {
+        SectionStats stats = GetStats(FrameSection(i));
+        if (stats.samples == 0)
+            continue;
+        snprintf(line, sizeof(line), "%-7s %7.2f %7.2f %7.2f\n", GetName(FrameSection(i)), stats.minMs, stats.avgMs,
+                 stats.p99Ms);
+        text += line;
+    }
+    return text;
+}
+
+bool FrameProfiler::StartCsv(const char *path)
+{
+    if (csv != nullptr)
+    {
+        WriteCsvRows(true);
+        fclose(csv);
+    }
+    csvRows.clear();
+
+    csv = fopen(path, "w");
+    if (csv == nullptr)
+        return false;
+
+    fprintf(csv, "frame");
+    for (int i = 0; i < cNumSections; i++)
+        fprintf(csv, ",%s_ms", GetName(FrameSection(i)));
+    fprintf(csv, "\n");
+    return true;
+}
+
+void FrameProfiler::WriteCsvRows(bool all)
+{
+    // Rows go out in frame order, so a row waiting for its GPU time holds back the ones after it
+    while (!csvRows.empty() && (all || csvRows.front().gpuKnown))
+    {
+        const CsvRow &row = csvRows.front();
+        fprintf(csv, "%llu", row.frame);
+        for (int i = 0; i < cNumSections; i++)
+        {
+            bool known = row.ms[i] >= 0.0f && (i != int(FrameSection::Gpu) || row.gpuKnown);
+            if (known)
+                fprintf(csv, ",%.3f", row.ms[i]);
+            else
+                fprintf(csv, ",");
+        }
+        fprintf(csv, "\n");
+        csvRows.pop_front();
+    }
+}
@@ -0,0 +1,104 @@
+#ifndef FRAME_PROFILER_HPP
+#define FRAME_PROFILER_HPP
+
+#include <glad/glad.h>
+
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <string>
+#include <vector>
+
+enum class FrameSection {
+  Frame,  // BeginFrame to the next BeginFrame, everything the loop does including sleeping
+  Update, // physics, timed by the caller with BeginCpu / EndCpu
+  Draw,   // draw submission on the CPU, BeginFrame to EndFrame
+  Swap,   // buffer swap and event polling, blocks when the GPU or vsync can't keep up
+  Gpu,    // GPU execution of everything between BeginFrame and EndFrame
+  Count
+};
+
+struct SectionStats {
+  float minMs = 0.0f;
+  float avgMs = 0.0f;
+  float p99Ms = 0.0f;
+  unsigned int samples = 0;
+};
+
+// Rolling CPU and GPU timings of the last frames.
+//
+// GPU time comes from GL_TIME_ELAPSED queries kept in a small ring: a query is only read back once
+// GL_QUERY_RESULT_AVAILABLE says it's done, a few frames later, so the CPU never waits on the GPU.
+// When every query of the ring is still in flight the GPU time of that frame is skipped instead.
+// With the stats of Frame, Update, Draw, Swap and Gpu side by side a slow frame can be pinned on
+// the simulation, on the GL driver (Draw) or on the GPU (Gpu, and Swap blocking).
+class FrameProfiler {
+
+public:
+  // Needs a current GL context
+  explicit FrameProfiler(unsigned int historySize = 240, unsigned int queryRingSize = 4);
+  ~FrameProfiler();
+
+  FrameProfiler(const FrameProfiler &) = delete;
+  FrameProfiler &operator=(const FrameProfiler &) = delete;
+
+  // Closes the previous frame, collects finished GPU queries and starts timing the next frame on both sides
+  void BeginFrame();
+  // Ends the GPU query of the current frame
+  void EndGpu();
+
+  // CPU sections can be entered several times a frame (e.g. several updates), the times add up
+  void BeginCpu(FrameSection section);
+  void EndCpu(FrameSection section);
+
+  SectionStats GetStats(FrameSection section) const;
+  static const char *GetName(FrameSection section);
+
+  // Table of min/avg/p99 of every section, one line per section
+  std::string FormatStats() const;
+
+  // Writes the times of every frame as a row of comma separated milliseconds. Rows are written once the
+  // GPU time of their frame is known, a few frames late.
+  bool StartCsv(const char *path);
+
+private:
+  static constexpr int cNumSections = int(FrameSection::Count);
+
+  using Clock = std::chrono::steady_clock;
+
+  struct QuerySlot {
+    unsigned int query = 0;
+    unsigned long long frame = 0;
+    bool pending = false;
+  };
+
+  struct CsvRow {
+    unsigned long long frame;
+    float ms[cNumSections];
+    bool gpuKnown;
+  };
+
+  void CollectQueries();
+  void AddSample(FrameSection section, float ms);
+  void WriteCsvRows(bool all);
+
+  unsigned int historySize;
+  std::vector<float> history[cNumSections]; // ring buffers of milliseconds
+  unsigned int historyNext[cNumSections] = {};
+
+  std::vector<QuerySlot> queries;
+  unsigned int nextQuery = 0;
+  QuerySlot *activeQuery = nullptr;
+
+  unsigned long long frame = 0;
+  Clock::time_point frameStart;
+  Clock::time_point sectionStart[cNumSections];
+  float frameMs[cNumSections] = {}; // CPU times of the current frame
+  bool timed[cNumSections] = {};
+  bool gpuIssued = false; // a query is running for the current frame
+
+  FILE *csv = nullptr;
+  std::deque<CsvRow> csvRows;
+};
+
+#endif // FRAME_PROFILER_HPP
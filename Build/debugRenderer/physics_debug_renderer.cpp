@@ -1,9 +1,31 @@
 #include "physics_debug_renderer.hpp"
 #include "glm/gtc/type_ptr.hpp"
 
+#ifdef DEBUG_RENDERER_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+#endif // DEBUG_RENDERER_EGL
+
+#include <Jolt/Physics/Body/BodyLock.h>
+
+#include <algorithm>
+#include <chrono>
+
 long ID_TOP_MERMAO = 0;
 
-// camera
+// TriangleData can outlive the renderer (Jolt keeps geometry references in its shapes), only free GPU buffers while there is a context
+static bool gl_context_alive = false;
+
+bool gl_context_is_alive()
+{
+    return gl_context_alive;
+}
+
+// camera, cameraPos is relative to renderOrigin so it stays small however far from the world origin we are
 glm::vec3 cameraPos = glm::vec3(0.0f, 1.0f, 10.0f);
 glm::vec3 cameraFront = glm::vec3(0.0f, 0.0f, -1.0f);
 glm::vec3 cameraUp = glm::vec3(0.0f, 4.0f, 0.0f);
@@ -15,6 +37,11 @@ float lastX = 800.0f / 2.0;
 float lastY = 600.0 / 2.0;
 float fov = 45.0f;
 
+// everything sent to the GPU is relative to this point, it jumps to the camera once the camera gets too far from it
+JPH::RVec3 renderOrigin = JPH::RVec3::sZero();
+unsigned int renderOriginVersion = 0;
+const float cRecenterDistance = 256.0f;
+
 // timing
 float deltaTime = 0.0f; // time between current frame and last frame
 float lastFrame = 0.0f;
@@ -111,16 +138,27 @@ static void error_callback(int error, const char *description)
 }
 
 
-glm::mat4 convert_mat4_from_jolt_to_glm(JPH::Mat44 input_matrix)
+void convert_to_render_space(const JPH::RMat44 *matrices, float *const *out, size_t count, JPH::RVec3Arg origin)
 {
-    glm::mat4 glm_mat;
-    for (int col = 0; col < 4; col++)
+    for (size_t i = 0; i < count; i++)
     {
-        for (int row = 0; row < 4; row++)
-        {
-            glm_mat[col][row] = input_matrix(row, col);
-        }
+        const JPH::RMat44 &m = matrices[i];
+        float *dst = out[i];
+
+        // Rotation and scale are floats already, only the translation needs the (double) subtraction
+        m.GetColumn4(0).StoreFloat4(reinterpret_cast<JPH::Float4 *>(dst));
+        m.GetColumn4(1).StoreFloat4(reinterpret_cast<JPH::Float4 *>(dst + 4));
+        m.GetColumn4(2).StoreFloat4(reinterpret_cast<JPH::Float4 *>(dst + 8));
+        JPH::Vec4(JPH::Vec3(m.GetTranslation() - origin), 1.0f).StoreFloat4(reinterpret_cast<JPH::Float4 *>(dst + 12));
     }
+}
+
+glm::mat4 convert_mat4_from_jolt_to_glm(JPH::RMat44Arg input_matrix, JPH::RVec3Arg origin)
+{
+    glm::mat4 glm_mat;
+    float *out = glm::value_ptr(glm_mat);
+    JPH::RMat44 matrix = input_matrix;
+    convert_to_render_space(&matrix, &out, 1, origin);
     return glm_mat;
 }
 
@@ -169,66 +207,59 @@ const char *fragmentShaderSource = "#version 330 core\n"
                                    "}\n\0";
 
 
-PhysicsDebugRenderer::PhysicsDebugRenderer()
+// Same lighting as above, but the transform and color come from per-instance attributes
+// so a whole group of bodies sharing one geometry goes out in a single draw call
+const char *instancedVertexShaderSource = "#version 330 core\n"
+                                          "layout (location = 0) in vec3 aPos;\n"
+                                          "layout (location = 1) in vec3 aNormal;\n"
+                                          "layout (location = 2) in mat4 local_to_world;\n"
+                                          "layout (location = 6) in vec3 instanceColor;\n"
+
+                                          "uniform mat4 view;\n"
+                                          "uniform mat4 projection;\n"
+
+                                          "out vec3 Normal;\n"
+                                          "out vec3 FragPos;\n"
+                                          "out vec3 Color;\n"
+
+                                          "void main()\n"
+                                          "{\n"
+                                          "   FragPos = vec3(local_to_world * vec4(aPos, 1.0));\n"
+                                          "   Normal = aNormal;\n"
+                                          "   Color = instanceColor;\n"
+                                          "   gl_Position = projection * view * vec4(FragPos, 1.0);\n"
+                                          "}\0";
+
+const char *instancedFragmentShaderSource = "#version 330 core\n"
+                                            "in vec3 Normal;\n"
+                                            "in vec3 FragPos;\n"
+                                            "in vec3 Color;\n"
+
+                                            "out vec4 FragColor;\n"
+
+                                            "uniform vec3 lightPos;\n"
+                                            "uniform vec3 lightColor;\n"
+                                            "void main()\n"
+                                            "{\n"
+                                            "   float ambientStrength = 1.0;\n"
+                                            "   vec3 ambient = ambientStrength * lightColor;\n"
+
+                                            "   vec3 norm = normalize(Normal);\n"
+                                            "   vec3 lightDir = normalize(lightPos - FragPos);\n"
+                                            "   float diff = max(dot(norm, lightDir), 0.0);\n"
+                                            "   vec3 diffuse = diff * lightColor;\n"
+
+                                            "   vec3 result = (ambient + diffuse) * Color;\n"
+                                            "   FragColor = vec4(result, 1.0);\n"
+                                            "}\n\0";
+
+// build and compile a shader program, exits when the shaders don't compile
+// -----------------------------------------------------------------------
+unsigned int build_shader_program(const char *vertex_source, const char *fragment_source)
 {
-    widthSize = 700;
-    heightSize = 700;
-    bool start_in_fullscreen = false;
-    bool start_with_mouse_captured = false;
-    unsigned int *window_width_px = &widthSize;
-    unsigned int *window_height_px = &heightSize;
-    const char *window_name = "window";
-
-    glfwSetErrorCallback(error_callback);
-
-    if (!glfwInit())
-    {
-        fprintf(stderr, "Error: %s\n", "glfw couldn't be initialized");
-        exit(1);
-    }
-
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-    if (start_in_fullscreen)
-    {
-        GLFWmonitor *monitor = glfwGetPrimaryMonitor();
-        const GLFWvidmode *mode = glfwGetVideoMode(monitor);
-        *window_width_px = mode->width;
-        *window_height_px = mode->height;
-        window = glfwCreateWindow(*window_width_px, *window_height_px, window_name, monitor, NULL);
-    }
-    else
-    {
-        window = glfwCreateWindow(*window_width_px, *window_height_px, window_name, NULL, NULL);
-    }
-
-    if (window == nullptr)
-    {
-        fprintf(stderr, "Error: %s\n", "Failed to create GLFW window");
-        glfwTerminate();
-        exit(1);
-    }
-
-    glfwMakeContextCurrent(window);
-    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-    glfwSetCursorPosCallback(window, mouse_callback);
-    glfwSetScrollCallback(window, scroll_callback);
-
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
-    {
-        fprintf(stderr, "Error: %s\n", "Failed to initialize GLAD");
-        exit(1);
-    }
-
-    glEnable(GL_DEPTH_TEST);
-
-    // build and compile our shader program
-    // ------------------------------------
     // vertex shader
     unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
+    glShaderSource(vertexShader, 1, &vertex_source, NULL);
     glCompileShader(vertexShader);
     int success;
     char infoLog[512];
@@ -241,7 +272,7 @@ PhysicsDebugRenderer::PhysicsDebugRenderer()
     }
     // fragment shader
     unsigned int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
+    glShaderSource(fragmentShader, 1, &fragment_source, NULL);
     glCompileShader(fragmentShader);
     // check for shader compile errors
     glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
@@ -253,7 +284,7 @@ PhysicsDebugRenderer::PhysicsDebugRenderer()
     }
 
     // link shaders
-    shaderProgram = glCreateProgram();
+    unsigned int shaderProgram = glCreateProgram();
     glAttachShader(shaderProgram, vertexShader);
     glAttachShader(shaderProgram, fragmentShader);
     glLinkProgram(shaderProgram);
@@ -268,13 +299,103 @@ PhysicsDebugRenderer::PhysicsDebugRenderer()
     glDeleteShader(vertexShader);
     glDeleteShader(fragmentShader);
 
+    return shaderProgram;
+}
+
+PhysicsDebugRenderer::PhysicsDebugRenderer(RenderTarget target, unsigned int width, unsigned int height)
+{
+    renderTarget = target;
+    widthSize = width;
+    heightSize = height;
+    bool start_in_fullscreen = false;
+    bool start_with_mouse_captured = false;
+    unsigned int *window_width_px = &widthSize;
+    unsigned int *window_height_px = &heightSize;
+    const char *window_name = "window";
+
+    if (renderTarget == RenderTarget::Surfaceless)
+    {
+        if (!CreateSurfacelessContext())
+        {
+            fprintf(stderr, "Error: %s\n", "Failed to create a surfaceless EGL context");
+            exit(1);
+        }
+    }
+    else
+    {
+        glfwSetErrorCallback(error_callback);
+
+        if (!glfwInit())
+        {
+            fprintf(stderr, "Error: %s\n", "glfw couldn't be initialized");
+            exit(1);
+        }
+
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+        if (renderTarget == RenderTarget::HiddenWindow)
+        {
+            glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        }
+
+        if (start_in_fullscreen)
+        {
+            GLFWmonitor *monitor = glfwGetPrimaryMonitor();
+            const GLFWvidmode *mode = glfwGetVideoMode(monitor);
+            *window_width_px = mode->width;
+            *window_height_px = mode->height;
+            window = glfwCreateWindow(*window_width_px, *window_height_px, window_name, monitor, NULL);
+        }
+        else
+        {
+            window = glfwCreateWindow(*window_width_px, *window_height_px, window_name, NULL, NULL);
+        }
+
+        if (window == nullptr)
+        {
+            fprintf(stderr, "Error: %s\n", "Failed to create GLFW window");
+            glfwTerminate();
+            exit(1);
+        }
+
+        glfwMakeContextCurrent(window);
+        glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+        glfwSetCursorPosCallback(window, mouse_callback);
+        glfwSetScrollCallback(window, scroll_callback);
+
+        if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+        {
+            fprintf(stderr, "Error: %s\n", "Failed to initialize GLAD");
+            exit(1);
+        }
+    }
+
+    if (IsOffscreen())
+    {
+        CreateOffscreenFramebuffer();
+    }
+
+    gl_context_alive = true;
+
+    glEnable(GL_DEPTH_TEST);
+
+    // build and compile our shader programs
+    // -------------------------------------
+    shaderProgram = build_shader_program(vertexShaderSource, fragmentShaderSource);
+    instancedShaderProgram = build_shader_program(instancedVertexShaderSource, instancedFragmentShaderSource);
+    text = new TextRenderer();
+    profiler = new FrameProfiler();
+    drawCommands = new DrawCommandQueue();
+
     // disable this for debugging so you can move the mouse outside the window
-    if (start_with_mouse_captured)
+    if (window != nullptr && start_with_mouse_captured)
     {
         glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
     }
 
-    if (glfwRawMouseMotionSupported())
+    if (window != nullptr && glfwRawMouseMotionSupported())
     {
         // logger.info("raw mouse motion supported, using it");
         glfwSetInputMode(window, GLFW_RAW_MOUSE_MOTION, GLFW_TRUE);
@@ -287,6 +408,252 @@ PhysicsDebugRenderer::PhysicsDebugRenderer()
     JPH::DebugRenderer::Initialize();
 }
 
+PhysicsDebugRenderer::~PhysicsDebugRenderer()
+{
+    delete drawCommands;
+    delete profiler;
+    delete text;
+
+    gl_context_alive = false;
+
+    if (capture != nullptr)
+    {
+        capture->Finish();
+        delete capture;
+    }
+
+    if (FBO != 0)
+    {
+        glDeleteFramebuffers(1, &FBO);
+        glDeleteRenderbuffers(1, &colorRBO);
+        glDeleteRenderbuffers(1, &depthRBO);
+    }
+
+#ifdef DEBUG_RENDERER_EGL
+    if (eglDisplay != nullptr)
+    {
+        eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroyContext(eglDisplay, eglContext);
+        eglTerminate(eglDisplay);
+    }
+#endif // DEBUG_RENDERER_EGL
+
+    if (window != nullptr)
+    {
+        glfwDestroyWindow(window);
+        glfwTerminate();
+    }
+}
+
+bool PhysicsDebugRenderer::CreateSurfacelessContext()
+{
+#ifdef DEBUG_RENDERER_EGL
+    // Prefer the Mesa surfaceless platform, it needs neither a display server nor a GPU
+    EGLDisplay display = EGL_NO_DISPLAY;
+    PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (get_platform_display != nullptr)
+        display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    if (display == EGL_NO_DISPLAY)
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+    EGLint major, minor;
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+        return false;
+
+    if (!eglBindAPI(EGL_OPENGL_API))
+        return false;
+
+    const EGLint config_attribs[] = {EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE};
+    EGLConfig config;
+    EGLint num_configs = 0;
+    if (!eglChooseConfig(display, config_attribs, &config, 1, &num_configs) || num_configs == 0)
+        return false;
+
+    const EGLint context_attribs[] = {EGL_CONTEXT_MAJOR_VERSION, 3,
+                                      EGL_CONTEXT_MINOR_VERSION, 3,
+                                      EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+                                      EGL_NONE};
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, context_attribs);
+    if (context == EGL_NO_CONTEXT)
+        return false;
+
+    // No surface at all, everything is drawn into our own framebuffer object
+    if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+        return false;
+
+    eglDisplay = display;
+    eglContext = context;
+
+    if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress))
+    {
+        fprintf(stderr, "Error: %s\n", "Failed to initialize GLAD");
+        return false;
+    }
+    return true;
+#else
+    fprintf(stderr, "Error: %s\n", "built without EGL support (DEBUG_RENDERER_EGL)");
+    return false;
+#endif // DEBUG_RENDERER_EGL
+}
+
+void PhysicsDebugRenderer::CreateOffscreenFramebuffer()
+{
+    glGenRenderbuffers(1, &colorRBO);
+    glBindRenderbuffer(GL_RENDERBUFFER, colorRBO);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, widthSize, heightSize);
+
+    glGenRenderbuffers(1, &depthRBO);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthRBO);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, widthSize, heightSize);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &FBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorRBO);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthRBO);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        fprintf(stderr, "Error: %s\n", "Offscreen framebuffer is incomplete");
+        exit(1);
+    }
+
+    glViewport(0, 0, widthSize, heightSize);
+}
+
+bool PhysicsDebugRenderer::StartCapture(const std::string &target, CaptureFormat format)
+{
+    if (capture != nullptr)
+    {
+        capture->Finish();
+        delete capture;
+    }
+
+    // Patterns become printf formats, refuse anything but a single %d before it gets there
+    if (!target.empty() && target[0] != '|' && target.find('%') != std::string::npos && !FrameCapture::IsValidPattern(target))
+    {
+        fprintf(stderr, "Error: capture pattern '%s' needs exactly one %%d (e.g. frame_%%05d.ppm), write %%%% for a literal %%\n",
+                target.c_str());
+        capture = nullptr;
+        return false;
+    }
+
+    capture = new FrameCapture(target, format, widthSize, heightSize);
+    if (!capture->IsOpen())
+    {
+        delete capture;
+        capture = nullptr;
+        return false;
+    }
+    return true;
+}
+
+void PhysicsDebugRenderer::UseInstancedProgram()
+{
+    glUseProgram(instancedShaderProgram);
+
+    glm::mat4 projection = glm::perspective(glm::radians(fov), (float)widthSize / (float)heightSize, 0.1f, 100.0f);
+    glUniformMatrix4fv(glGetUniformLocation(instancedShaderProgram, "projection"), 1, GL_FALSE, &projection[0][0]);
+
+    glm::mat4 view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
+    glUniformMatrix4fv(glGetUniformLocation(instancedShaderProgram, "view"), 1, GL_FALSE, &view[0][0]);
+
+    glUniform3f(glGetUniformLocation(instancedShaderProgram, "lightPos"), 20.0f, 20.0f, 20.0f);
+    glUniform3f(glGetUniformLocation(instancedShaderProgram, "lightColor"), 1.0f, 1.0f, 1.0f);
+}
+
+void PhysicsDebugRenderer::SetCameraPosition(JPH::RVec3Arg position)
+{
+    renderOrigin = position;
+    cameraPos = glm::vec3(0.0f);
+    renderOriginVersion++;
+}
+
+JPH::RVec3 PhysicsDebugRenderer::GetCameraPosition() const
+{
+    return renderOrigin + JPH::Vec3(cameraPos.x, cameraPos.y, cameraPos.z);
+}
+
+JPH::RVec3 PhysicsDebugRenderer::GetRenderOrigin() const
+{
+    return renderOrigin;
+}
+
+unsigned int PhysicsDebugRenderer::GetRenderOriginVersion() const
+{
+    return renderOriginVersion;
+}
+
+bool PhysicsDebugRenderer::ShouldClose() const
+{
+    return window != nullptr && glfwWindowShouldClose(window);
+}
+
+void PhysicsDebugRenderer::BeginFrame()
+{
+    profiler->BeginFrame();
+
+    // glfw isn't initialized in surfaceless mode, keep our own clock there
+    static const std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+    float currentFrame = window != nullptr ? static_cast<float>(glfwGetTime())
+                                           : std::chrono::duration<float>(std::chrono::steady_clock::now() - start_time).count();
+    deltaTime = currentFrame - lastFrame;
+    lastFrame = currentFrame;
+
+    // input
+    // -----
+    if (window != nullptr)
+        processInput(window);
+
+    // Keep float positions close to zero: once the camera wanders off, move the origin to the camera
+    if (glm::length(cameraPos) > cRecenterDistance)
+        SetCameraPosition(GetCameraPosition());
+
+    glm::mat4 projection = glm::perspective(glm::radians(fov), (float)widthSize / (float)heightSize, 0.1f, 100.0f);
+    viewProjection = projection * glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
+
+    if (FBO != 0)
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+
+    // glClearColor(0.05f, 0.05f, 0.05f, 1.0f);
+    glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    profiler->BeginCpu(FrameSection::Draw);
+}
+
+void PhysicsDebugRenderer::EndFrame()
+{
+    // Everything DrawGeometry queued this frame, from whatever thread
+    UseInstancedProgram();
+    drawCommands->Submit();
+
+    if (showProfiler)
+        DrawText2D(8.0f, heightSize - 24.0f, profiler->FormatStats(), JPH::Color::sYellow);
+
+    text->Flush(widthSize, heightSize);
+
+    profiler->EndCpu(FrameSection::Draw);
+    profiler->EndGpu();
+
+    if (capture != nullptr)
+    {
+        // Reads from the offscreen framebuffer, or the back buffer when capturing a visible window
+        glReadBuffer(FBO != 0 ? GL_COLOR_ATTACHMENT0 : GL_BACK);
+        capture->Capture();
+    }
+
+    if (window != nullptr)
+    {
+        profiler->BeginCpu(FrameSection::Swap);
+        if (renderTarget == RenderTarget::Window)
+            glfwSwapBuffers(window);
+        glfwPollEvents();
+        profiler->EndCpu(FrameSection::Swap);
+    }
+}
+
 void PhysicsDebugRenderer::DrawLine(JPH::RVec3Arg inFrom, JPH::RVec3Arg inTo, JPH::ColorArg inColor)
 {
 
@@ -306,13 +673,6 @@ JPH::DebugRenderer::Batch PhysicsDebugRenderer::CreateTriangleBatch(const Vertex
     return triangle_data;
 }
 
-glm::vec3 getColor(JPH::ColorArg color) {
-    float red =  color.r / 254.0f;
-    float green =  color.g / 254.0f;
-    float blue =  color.b / 254.0f;
-    return glm::vec3(red, green, blue);
-}
-
 void PhysicsDebugRenderer::DrawGeometry(JPH::RMat44Arg inModelMatrix, const JPH::AABox &inWorldSpaceBounds,
                                         float inLODScaleSq, JPH::ColorArg inModelColor, const GeometryRef &inGeometry,
                                         ECullMode inCullMode, ECastShadow inCastShadow, EDrawMode inDrawMode)
@@ -323,94 +683,107 @@ void PhysicsDebugRenderer::DrawGeometry(JPH::RMat44Arg inModelMatrix, const JPH:
      * the createTriangleBatch function, so those must be implemented before you implement
      * this or else it will not work, each BatchImpl which impelments RenderPrimitive
      */
-    const JPH::Array<LOD> &geometry_lods = inGeometry->mLODs;
-    // use lod 0 because our game doesn't use LOD at all
-    TriangleData *triangle_batch = static_cast<TriangleData *>(geometry_lods[0].mTriangleBatch.GetPtr());
-    
-    glm::vec3 cor = getColor(inModelColor);
-    if (triangle_batch->uses_indices)
+    if (recording != nullptr)
     {
-        glBindVertexArray(VAO);
-
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferData(GL_ARRAY_BUFFER,
-                     triangle_batch->vertices.size() * sizeof(float),
-                     &triangle_batch->vertices.front(),
-                     GL_DYNAMIC_DRAW);
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-                     triangle_batch->indices.size() * sizeof(JPH::uint32),
-                     &triangle_batch->indices.front(),
-                     GL_DYNAMIC_DRAW);
-
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)0);
-        glEnableVertexAttribArray(0);
-
-        float currentFrame = static_cast<float>(glfwGetTime());
-        deltaTime = currentFrame - lastFrame;
-        lastFrame = currentFrame;
-
-        // input
-        // -----
-        processInput(window);
-
-        //=======================================
+        recording->push_back({inGeometry, inModelMatrix, inModelColor, inDrawMode});
+        return;
+    }
 
-        glUseProgram(shaderProgram);
+    // use lod 0 because our game doesn't use LOD at all
+    TriangleData *triangle_batch = static_cast<TriangleData *>(inGeometry->mLODs[0].mTriangleBatch.GetPtr());
 
-        // pass projection matrix to shader (note that in this case it could change every frame)
-        glm::mat4 projection = glm::perspective(glm::radians(fov), (float)widthSize / (float)heightSize, 0.1f, 100.0f);
-        glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "projection"), 1, GL_FALSE, &projection[0][0]);
+    // Converting to render space is most of the work, it happens here on the recording thread
+    float local_to_world[16];
+    float *out = local_to_world;
+    JPH::RMat44 model_matrix = inModelMatrix;
+    convert_to_render_space(&model_matrix, &out, 1, renderOrigin);
 
-        // camera/view transformation
-        glm::mat4 view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
-        glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "view"), 1, GL_FALSE, &view[0][0]);
+    drawCommands->Record(triangle_batch, inDrawMode == EDrawMode::Wireframe, local_to_world, inModelColor);
+}
 
-        glm::mat4 local_to_world = convert_mat4_from_jolt_to_glm(inModelMatrix);
-        glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "local_to_world"), 1, GL_FALSE, glm::value_ptr(local_to_world));
+JPH::Color body_draw_color(const JPH::Body &body)
+{
+    switch (body.GetMotionType())
+    {
+    case JPH::EMotionType::Static:
+        return JPH::Color::sGrey;
+    case JPH::EMotionType::Kinematic:
+        return JPH::Color::sGreen;
+    default:
+        return JPH::Color::sGetDistinctColor(body.GetID().GetIndex());
+    }
+}
 
+void PhysicsDebugRenderer::DrawBodies(const JPH::PhysicsSystem &system, JPH::JobSystem &jobSystem)
+{
+    system.GetBodies(drawBodies);
+    const JPH::BodyLockInterfaceNoLock &lock_interface = system.GetBodyLockInterfaceNoLock();
 
-        glUniform3fv(glGetUniformLocation(shaderProgram, "ourColor"), 1, &cor[0]);
-        glUniform3f(glGetUniformLocation(shaderProgram, "lightPos"), 20.0f,20.0f,20.0f);
-        glUniform3f(glGetUniformLocation(shaderProgram, "lightColor"), 1.0f, 1.0f, 1.0f);
+    // Forget shapes that only we still hold, no body uses them anymore
+    for (auto it = warmShapes.begin(); it != warmShapes.end();)
+    {
+        if (it->second->GetRefCount() == 1)
+            it = warmShapes.erase(it);
+        else
+            ++it;
+    }
 
-        if (inDrawMode ==  EDrawMode::Wireframe) {
-            glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-        } else {
-            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    // Shapes create their debug geometry the first time they're drawn (e.g. ConvexHullShape, MeshShape) and
+    // that isn't thread safe. Draw the bodies with shapes we haven't drawn before on this thread first.
+    drawnSerially.assign(drawBodies.size(), 0);
+    for (size_t i = 0; i < drawBodies.size(); i++)
+    {
+        JPH::BodyLockRead lock(lock_interface, drawBodies[i]);
+        if (!lock.Succeeded())
+        {
+            drawnSerially[i] = 1;
+            continue;
         }
 
-        glDrawElements(GL_TRIANGLES, triangle_batch->indices.size(), GL_UNSIGNED_INT, 0);
+        const JPH::Body &body = lock.GetBody();
+        const JPH::Shape *shape = body.GetShape();
+        if (warmShapes.find(shape) == warmShapes.end())
+        {
+            // Keep a reference, a new shape at the same address would otherwise pass as warm
+            warmShapes.emplace(shape, shape);
+            body.GetShape()->Draw(this, body.GetCenterOfMassTransform(), JPH::Vec3::sReplicate(1.0f), body_draw_color(body), false, false);
+            drawnSerially[i] = 1;
+        }
     }
-    else
-    {
-        printf("Entrou aqui e nunca tinha entrado\n");
-        printf("Entrou aqui e nunca tinha entrado\n");
-        printf("Entrou aqui e nunca tinha entrado\n");
 
-        // glUseProgram(shaderProgram);
-        // glBindVertexArray(VAO);
-        // glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        // glBufferData(GL_ARRAY_BUFFER, triangle_batch->triangle_vertices.size() * sizeof(float),
-        //              &triangle_batch->triangle_vertices.front(), GL_STATIC_DRAW);
-
-        // // pass projection matrix to shader (note that in this case it could change every frame)
-        // glm::mat4 projection = glm::perspective(glm::radians(fov), (float)widthSize / (float)heightSize, 0.1f, 100.0f);
-        // glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "projection"), 1, GL_FALSE, &projection[0][0]);
-
-        // // camera/view transformation
-        // glm::mat4 view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
-        // glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "view"), 1, GL_FALSE, &view[0][0]);
+    auto draw_range = [this, &lock_interface](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++)
+        {
+            if (drawnSerially[i])
+                continue;
+            JPH::BodyLockRead lock(lock_interface, drawBodies[i]);
+            if (!lock.Succeeded())
+                continue;
+            const JPH::Body &body = lock.GetBody();
+            body.GetShape()->Draw(this, body.GetCenterOfMassTransform(), JPH::Vec3::sReplicate(1.0f), body_draw_color(body), false, false);
+        }
+    };
 
-        // glm::mat4 local_to_world = convert_mat4_from_jolt_to_glm(inModelMatrix);
-        // GLint local_to_world_uniform_location = glGetUniformLocation(shaderProgram, "local_to_world");
-        // glUniformMatrix4fv(local_to_world_uniform_location, 1, GL_FALSE, glm::value_ptr(local_to_world));
+    // A few chunks per thread so threads that finish early can pick up more work
+    size_t count = drawBodies.size();
+    size_t max_chunks = size_t(std::max(1, jobSystem.GetMaxConcurrency())) * 4;
+    size_t chunk_size = std::max<size_t>(256, (count + max_chunks - 1) / max_chunks);
+    if (chunk_size >= count)
+    {
+        draw_range(0, count);
+        return;
+    }
 
-        // glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-        // glDrawArrays(GL_TRIANGLES, 0, triangle_batch->num_triangles * 3);
-        // glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    JPH::JobSystem::Barrier *barrier = jobSystem.CreateBarrier();
+    for (size_t begin = 0; begin < count; begin += chunk_size)
+    {
+        size_t end = std::min(begin + chunk_size, count);
+        barrier->AddJob(jobSystem.CreateJob("DrawBodies", JPH::Color::sGreen, [&draw_range, begin, end]() { draw_range(begin, end); }));
     }
+
+    // The calling thread helps recording while it waits
+    jobSystem.WaitForJobs(barrier);
+    jobSystem.DestroyBarrier(barrier);
 }
 
 void PhysicsDebugRenderer::DrawTriangle(JPH::RVec3Arg inV1, JPH::RVec3Arg inV2, JPH::RVec3Arg inV3,
@@ -422,7 +795,32 @@ void PhysicsDebugRenderer::DrawTriangle(JPH::RVec3Arg inV1, JPH::RVec3Arg inV2,
 void PhysicsDebugRenderer::DrawText3D(JPH::RVec3Arg inPosition, const JPH::string_view &inString, JPH::ColorArg inColor,
                                       float inHeight)
 {
-    printf("trying to draw triangle\n");
+    JPH::Vec3 position(inPosition - renderOrigin);
+    glm::vec4 clip = viewProjection * glm::vec4(position.GetX(), position.GetY(), position.GetZ(), 1.0f);
+
+    // Behind the camera or beyond the far plane
+    if (clip.w < 0.1f || clip.w > 100.0f)
+        return;
+
+    // inHeight is in world units, scale it like the perspective projection does. Labels too small to read are
+    // skipped, with thousands of bodies most of them are far away.
+    float pixel_height = inHeight * heightSize / (2.0f * tanf(glm::radians(fov) * 0.5f) * clip.w);
+    if (pixel_height < 4.0f)
+        return;
+
+    // Skip labels that are entirely off screen
+    float x = (clip.x / clip.w * 0.5f + 0.5f) * widthSize;
+    float y = (clip.y / clip.w * 0.5f + 0.5f) * heightSize;
+    float max_width = pixel_height * TextRenderer::cGlyphWidth / TextRenderer::cGlyphHeight * inString.size();
+    if (x > widthSize || y > heightSize || x + max_width < 0.0f || y + pixel_height < 0.0f)
+        return;
+
+    text->AddText(x, y, pixel_height, inString, inColor);
+}
+
+void PhysicsDebugRenderer::DrawText2D(float x, float y, const JPH::string_view &string, JPH::ColorArg color, float pixelHeight)
+{
+    text->AddText(x, y, pixelHeight, string, color);
 }
 
 TriangleData::TriangleData(const JPH::DebugRenderer::Triangle *triangles, int num_triangles)
@@ -471,3 +869,38 @@ TriangleData::TriangleData(const JPH::DebugRenderer::Vertex *vertices, int num_v
         this->indices.push_back(index);
     }
 }
+
+TriangleData::~TriangleData()
+{
+    if (gl_context_alive && VBO != 0)
+    {
+        glDeleteBuffers(1, &VBO);
+        if (EBO != 0)
+            glDeleteBuffers(1, &EBO);
+    }
+}
+
+void TriangleData::BindBuffers()
+{
+    if (VBO == 0)
+    {
+        const std::vector<float> &positions = uses_indices ? vertices : triangle_vertices;
+        glGenBuffers(1, &VBO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(float), positions.data(), GL_STATIC_DRAW);
+
+        if (uses_indices)
+        {
+            glGenBuffers(1, &EBO);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(JPH::uint32), indices.data(), GL_STATIC_DRAW);
+        }
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)0);
+    glEnableVertexAttribArray(0);
+
+    if (EBO != 0)
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+}
@@ -8,18 +8,97 @@
 
 #include <Jolt/Jolt.h>
 #include <Jolt/Renderer/DebugRenderer.h>
+#include <Jolt/Core/JobSystem.h>
+#include <Jolt/Physics/PhysicsSystem.h>
 
 #include <glad/glad.h>
 #include <glm/gtc/matrix_transform.hpp>
 #include <GLFW/glfw3.h>
 
+#include <unordered_map>
+#include <vector>
+
+#include "frame_capture.hpp"
+#include "draw_command_queue.hpp"
+#include "frame_profiler.hpp"
+#include "text_renderer.hpp"
+
 
 extern long ID_TOP_MERMAO;
 
+// Converts model matrices to column major float matrices (glm::mat4 layout) relative to origin. A plain loop over
+// the matrices: the rotation columns are copied as they are (floats in both builds) and only the translation is
+// subtracted from origin in double precision (JPH_DOUBLE_PRECISION) before it's rounded to float. Each matrix uses
+// Jolt's SIMD registers (Vec4 columns, one DVec3 subtraction), there is no vectorization across matrices.
+void convert_to_render_space(const JPH::RMat44 *matrices, float *const *out, size_t count, JPH::RVec3Arg origin);
+
+// Same coloring as BodyManager::DrawSettings::mDrawShapeColor = MotionTypeColor
+JPH::Color body_draw_color(const JPH::Body &body);
+
+// False once the renderer is gone, objects holding GL resources check this before freeing them
+bool gl_context_is_alive();
+
+// Compiles and links a vertex and fragment shader, exits when they don't compile
+unsigned int build_shader_program(const char *vertex_source, const char *fragment_source);
+
+enum class RenderTarget {
+  Window,       // visible GLFW window, rendering to the default framebuffer
+  HiddenWindow, // invisible GLFW window, rendering to an offscreen framebuffer (needs a display, e.g. Xvfb)
+  Surfaceless,  // no window system at all, EGL surfaceless context (Mesa llvmpipe on GPU-less machines)
+};
+
 class PhysicsDebugRenderer final : public JPH::DebugRenderer {
 
 public:
-  PhysicsDebugRenderer();
+  PhysicsDebugRenderer(RenderTarget target = RenderTarget::Window, unsigned int width = 700, unsigned int height = 700);
+  ~PhysicsDebugRenderer() override;
+
+  // Binds the render target, clears it and handles input, call before drawing the bodies
+  void BeginFrame();
+  // Captures the frame if capturing, presents it if there is a visible window and polls events
+  void EndFrame();
+
+  // Starts streaming every frame to target, see FrameCapture for the accepted targets
+  bool StartCapture(const std::string &target, CaptureFormat format);
+
+  // CPU and GPU times of the last frames. Draw, Swap and Gpu are timed by BeginFrame / EndFrame,
+  // time physics with GetProfiler().BeginCpu(FrameSection::Update) / EndCpu.
+  FrameProfiler &GetProfiler() { return *profiler; }
+  // Shows the min/avg/p99 table of the profiler in the top left corner
+  void SetProfilerOverlay(bool show) { showProfiler = show; }
+
+  bool ShouldClose() const;
+  bool IsOffscreen() const { return renderTarget != RenderTarget::Window; }
+
+  // A DrawGeometry call captured instead of drawn, see BeginRecording
+  struct RecordedGeometry {
+    GeometryRef geometry;
+    JPH::RMat44 modelMatrix;
+    JPH::Color color;
+    EDrawMode drawMode;
+  };
+
+  // While recording, DrawGeometry appends to out instead of drawing, used to find out which
+  // geometry a shape draws with (e.g. shape->Draw(renderer, ...)) without putting it on screen
+  void BeginRecording(std::vector<RecordedGeometry> *out) { recording = out; }
+  void EndRecording() { recording = nullptr; }
+
+  // The camera in world space, moving it also moves the render origin (see GetRenderOrigin)
+  void SetCameraPosition(JPH::RVec3Arg position);
+  JPH::RVec3 GetCameraPosition() const;
+
+  // Everything is drawn relative to this point so floats keep their precision far away from the world origin.
+  // The version changes whenever it moves, data converted against an older origin must be converted again.
+  JPH::RVec3 GetRenderOrigin() const;
+  unsigned int GetRenderOriginVersion() const;
+
+  // Binds instancedShaderProgram with the current camera and light, see BodyInstanceCache
+  void UseInstancedProgram();
+
+  // Draws all bodies like PhysicsSystem::DrawBodies, but prepares the draw commands of chunks of bodies on
+  // the job system. Call between PhysicsSystem::Update calls.
+  void DrawBodies(const JPH::PhysicsSystem &system, JPH::JobSystem &jobSystem);
+  const DrawCommandQueue &GetDrawCommands() const { return *drawCommands; }
 
   void DrawLine(JPH::RVec3Arg inFrom, JPH::RVec3Arg inTo, JPH::ColorArg inColor) override;
   void DrawTriangle(JPH::RVec3Arg inV1, JPH::RVec3Arg inV2, JPH::RVec3Arg inV3, JPH::ColorArg inColor,
@@ -29,18 +108,46 @@ public:
   Batch CreateTriangleBatch(const Vertex *inVertices, int inVertexCount, const JPH::uint32 *inIndices,
                                     int inIndexCount) override;
 
+  // Thread safe unless recording (see BeginRecording): the geometry is queued on a command list of the calling
+  // thread, EndFrame draws the commands of all threads sorted by geometry
   void DrawGeometry(JPH::RMat44Arg inModelMatrix, const JPH::AABox &inWorldSpaceBounds, float inLODScaleSq,
                             JPH::ColorArg inModelColor, const GeometryRef &inGeometry, ECullMode inCullMode,
                             ECastShadow inCastShadow, EDrawMode inDrawMode) override;
+  // Labels are projected to the screen and queued, all text of a frame is drawn at once in EndFrame
   void DrawText3D(JPH::RVec3Arg inPosition, const JPH::string_view &inString, JPH::ColorArg inColor,
                           float inHeight) override;
+  // Text at a fixed pixel position, (0, 0) is the bottom left of the viewport
+  void DrawText2D(float x, float y, const JPH::string_view &string, JPH::ColorArg color, float pixelHeight = 16.0f);
 
 
-  GLFWwindow *window;
+  GLFWwindow *window = nullptr;
   unsigned int widthSize;
   unsigned int heightSize;
   unsigned int VBO, EBO, VAO;
   unsigned int shaderProgram;
+  unsigned int instancedShaderProgram;
+
+private:
+  bool CreateSurfacelessContext();
+  void CreateOffscreenFramebuffer();
+
+  RenderTarget renderTarget;
+  unsigned int FBO = 0, colorRBO = 0, depthRBO = 0;
+  FrameCapture *capture = nullptr;
+  TextRenderer *text = nullptr;
+  FrameProfiler *profiler = nullptr;
+  DrawCommandQueue *drawCommands = nullptr;
+
+  // Shapes build their debug geometry the first time they're drawn, which isn't thread safe, see DrawBodies.
+  // Entries are dropped once ours is the last reference.
+  std::unordered_map<const JPH::Shape *, JPH::RefConst<JPH::Shape>> warmShapes;
+  JPH::BodyIDVector drawBodies;
+  std::vector<char> drawnSerially;
+  bool showProfiler = false;
+  glm::mat4 viewProjection = glm::mat4(1.0f); // camera of the current frame, for projecting labels
+  std::vector<RecordedGeometry> *recording = nullptr;
+  void *eglDisplay = nullptr;
+  void *eglContext = nullptr;
 };
 
 class ThatIHaveToMake : public JPH::RefTarget<ThatIHaveToMake> {};
@@ -50,6 +157,10 @@ public:
   
   TriangleData(const JPH::DebugRenderer::Triangle *triangles, int num_triangles) ;
   TriangleData(const JPH::DebugRenderer::Vertex *vertices, int num_vertices, const JPH::uint32 *indices, int num_indices);
+  ~TriangleData();
+
+  // Uploads the vertices (and indices) into GPU buffers once, binds them to the current VAO
+  void BindBuffers();
 
   virtual void AddRef() override { ThatIHaveToMake::AddRef(); }
   virtual void Release() override { if (--mRefCount == 0) delete this; }
@@ -60,6 +171,7 @@ public:
   std::vector<JPH::uint32> indices;
   long idTriangulo = ++ID_TOP_MERMAO;
   bool uses_indices;
+  unsigned int VBO = 0, EBO = 0;
 };
 
 #endif // PHYSICS_DEBUG_RENDERER_HPP
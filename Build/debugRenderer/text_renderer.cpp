@@ -0,0 +1,290 @@
+#include "text_renderer.hpp"
+#include "physics_debug_renderer.hpp"
+#include "text_shaders.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+// Printable ASCII (32 to 126), one byte per row with the leftmost pixel in the high bit.
+// Rasterized from DejaVu Sans Mono at 14 pixels. The glyph data is derived from the Bitstream Vera fonts, whose
+// license asks for the notice below to be included with it (DejaVu changes are in the public domain):
+//
+// Copyright (c) 2003 by Bitstream, Inc. All Rights Reserved. Bitstream Vera is a trademark of Bitstream, Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of the fonts accompanying this
+// license ("Fonts") and associated documentation files (the "Font Software"), to reproduce and distribute the Font
+// Software, including without limitation the rights to use, copy, merge, publish, distribute, and/or sell copies of
+// the Font Software, and to permit persons to whom the Font Software is furnished to do so, subject to the following
+// conditions:
+//
+// The above copyright and trademark notices and this permission notice shall be included in all copies of one or
+// more of the Font Software typefaces.
+//
+// The Font Software may be modified, altered, or added to, and in particular the designs of glyphs or characters in
+// the Fonts may be modified and additional glyphs or characters may be added to the Fonts, only if the fonts are
+// renamed to names not containing either the words "Bitstream" or the word "Vera".
+//
+// This License becomes null and void to the extent applicable to Fonts or Font Software that has been modified and is
+// distributed under the "Bitstream Vera" names.
+//
+// The Font Software may be sold as part of a larger software package but no copy of one or more of the Font Software
+// typefaces may be sold by itself.
+//
+// THE FONT SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// ANY WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT OF COPYRIGHT, PATENT,
+// TRADEMARK, OR OTHER RIGHT. IN NO EVENT SHALL BITSTREAM OR THE GNOME FOUNDATION BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, INCLUDING ANY GENERAL, SPECIAL, INDIRECT, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF THE USE OR INABILITY TO USE THE FONT SOFTWARE OR FROM OTHER
+// DEALINGS IN THE FONT SOFTWARE.
+//
+// Except as contained in this notice, the names of Gnome, the Gnome Foundation, and Bitstream Inc., shall not be used
+// in advertising or otherwise to promote the sale, use or other dealings in this Font Software without prior written
+// authorization from the Gnome Foundation or Bitstream Inc., respectively. For further information, contact: fonts at
+// gnome dot org.
+static const unsigned char cFont8x16[95][16] = {
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // ' '
+    {0x00, 0x00, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x08, 0x00, 0x08, 0x18, 0x00, 0x00, 0x00, 0x00}, // '!'
+    {0x00, 0x00, 0x34, 0x34, 0x34, 0x34, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // '"'
+    {0x00, 0x00, 0x1a, 0x12, 0x12, 0x7f, 0x36, 0x24, 0xff, 0x6c, 0x68, 0x48, 0x00, 0x00, 0x00, 0x00}, // '#'
+    {0x00, 0x08, 0x08, 0x3e, 0x6a, 0x68, 0x78, 0x1e, 0x0a, 0x0b, 0x4a, 0x3e, 0x08, 0x08, 0x00, 0x00}, // '$'
+    {0x00, 0x00, 0x70, 0xd8, 0xd8, 0x73, 0x0c, 0x30, 0x46, 0x09, 0x09, 0x0f, 0x00, 0x00, 0x00, 0x00}, // '%'
+    {0x00, 0x00, 0x3c, 0x20, 0x20, 0x20, 0x70, 0x49, 0xcd, 0xc7, 0x66, 0x3f, 0x00, 0x00, 0x00, 0x00}, // '&'
+    {0x00, 0x00, 0x18, 0x18, 0x18, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // '\''
+    {0x00, 0x04, 0x08, 0x08, 0x18, 0x18, 0x10, 0x10, 0x10, 0x18, 0x18, 0x08, 0x0c, 0x04, 0x00, 0x00}, // '('
+    {0x00, 0x10, 0x10, 0x18, 0x08, 0x08, 0x0c, 0x0c, 0x0c, 0x08, 0x08, 0x18, 0x10, 0x00, 0x00, 0x00}, // ')'
+    {0x00, 0x00, 0x08, 0x4a, 0x3c, 0x1c, 0x6e, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // '*'
+    {0x00, 0x00, 0x00, 0x00, 0x08, 0x08, 0x08, 0x7f, 0x18, 0x08, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00}, // '+'
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x18, 0x10, 0x00, 0x00}, // ','
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3c, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // '-'
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x00, 0x00, 0x00, 0x00}, // '.'
+    {0x00, 0x00, 0x02, 0x06, 0x04, 0x0c, 0x08, 0x18, 0x10, 0x30, 0x30, 0x20, 0x60, 0x40, 0x00, 0x00}, // '/'
+    {0x00, 0x00, 0x3c, 0x26, 0x62, 0x63, 0x5b, 0x5b, 0x63, 0x62, 0x26, 0x3c, 0x00, 0x00, 0x00, 0x00}, // '0'
+    {0x00, 0x00, 0x38, 0x28, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x0c, 0x3f, 0x00, 0x00, 0x00, 0x00}, // '1'
+    {0x00, 0x00, 0x7c, 0x66, 0x02, 0x06, 0x06, 0x0c, 0x18, 0x30, 0x60, 0x7e, 0x00, 0x00, 0x00, 0x00}, // '2'
+    {0x00, 0x00, 0x7c, 0x46, 0x02, 0x06, 0x1c, 0x06, 0x02, 0x02, 0x46, 0x7c, 0x00, 0x00, 0x00, 0x00}, // '3'
+    {0x00, 0x00, 0x0e, 0x0e, 0x16, 0x36, 0x26, 0x46, 0x7f, 0x06, 0x06, 0x06, 0x00, 0x00, 0x00, 0x00}, // '4'
+    {0x00, 0x00, 0x7e, 0x60, 0x60, 0x7c, 0x06, 0x02, 0x02, 0x02, 0x46, 0x7c, 0x00, 0x00, 0x00, 0x00}, // '5'
+    {0x00, 0x00, 0x1e, 0x30, 0x60, 0x7c, 0x66, 0x62, 0x63, 0x62, 0x66, 0x3c, 0x00, 0x00, 0x00, 0x00}, // '6'
+    {0x00, 0x00, 0x7e, 0x06, 0x06, 0x04, 0x0c, 0x0c, 0x08, 0x18, 0x10, 0x30, 0x00, 0x00, 0x00, 0x00}, // '7'
+    {0x00, 0x00, 0x3c, 0x66, 0x62, 0x66, 0x3c, 0x66, 0x43, 0x43, 0x66, 0x3c, 0x00, 0x00, 0x00, 0x00}, // '8'
+    {0x00, 0x00, 0x3c, 0x66, 0x42, 0x42, 0x67, 0x3f, 0x02, 0x02, 0x0e, 0x3c, 0x00, 0x00, 0x00, 0x00}, // '9'
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x00, 0x00, 0x00, 0x18, 0x18, 0x00, 0x00, 0x00, 0x00}, // ':'
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x00, 0x00, 0x00, 0x18, 0x18, 0x18, 0x10, 0x00, 0x00}, // ';'
+    {0x00, 0x00, 0x00, 0x00, 0x03, 0x0e, 0x78, 0xe0, 0x78, 0x0e, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00}, // '<'
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0x00, 0x00, 0xff, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // '='
+    {0x00, 0x00, 0x00, 0x00, 0x40, 0x78, 0x1e, 0x03, 0x0e, 0x78, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00}, // '>'
+    {0x00, 0x00, 0x3c, 0x26, 0x02, 0x06, 0x0c, 0x18, 0x18, 0x00, 0x18, 0x18, 0x00, 0x00, 0x00, 0x00}, // '?'
+    {0x00, 0x00, 0x1e, 0x23, 0x41, 0xcf, 0x9b, 0x91, 0x91, 0x93, 0xcf, 0x40, 0x30, 0x1e, 0x00, 0x00}, // '@'
+    {0x00, 0x00, 0x18, 0x1c, 0x34, 0x34, 0x26, 0x26, 0x7e, 0x62, 0x43, 0xc1, 0x00, 0x00, 0x00, 0x00}, // 'A'
+    {0x00, 0x00, 0x7c, 0x66, 0x62, 0x66, 0x7c, 0x66, 0x63, 0x63, 0x67, 0x7e, 0x00, 0x00, 0x00, 0x00}, // 'B'
+    {0x00, 0x00, 0x1e, 0x32, 0x60, 0x60, 0x60, 0x60, 0x60, 0x60, 0x32, 0x1e, 0x00, 0x00, 0x00, 0x00}, // 'C'
+    {0x00, 0x00, 0x7c, 0x6e, 0x42, 0x43, 0x43, 0x43, 0x43, 0x42, 0x6e, 0x7c, 0x00, 0x00, 0x00, 0x00}, // 'D'
+    {0x00, 0x00, 0x7f, 0x60, 0x60, 0x60, 0x7e, 0x60, 0x60, 0x60, 0x60, 0x7f, 0x00, 0x00, 0x00, 0x00}, // 'E'
+    {0x00, 0x00, 0x7f, 0x60, 0x60, 0x60, 0x7e, 0x60, 0x60, 0x60, 0x60, 0x60, 0x00, 0x00, 0x00, 0x00}, // 'F'
+    {0x00, 0x00, 0x1e, 0x32, 0x60, 0x40, 0x47, 0x43, 0x43, 0x63, 0x33, 0x1e, 0x00, 0x00, 0x00, 0x00}, // 'G'
+    {0x00, 0x00, 0x43, 0x43, 0x43, 0x43, 0x7f, 0x63, 0x43, 0x43, 0x43, 0x43, 0x00, 0x00, 0x00, 0x00}, // 'H'
+    {0x00, 0x00, 0x7e, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x7e, 0x00, 0x00, 0x00, 0x00}, // 'I'
+    {0x00, 0x00, 0x3e, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x4c, 0x7c, 0x00, 0x00, 0x00, 0x00}, // 'J'
+    {0x00, 0x00, 0x43, 0x46, 0x4c, 0x58, 0x78, 0x68, 0x4c, 0x46, 0x42, 0x43, 0x00, 0x00, 0x00, 0x00}, // 'K'
+    {0x00, 0x00, 0x60, 0x60, 0x60, 0x60, 0x60, 0x60, 0x60, 0x60, 0x60, 0x7f, 0x00, 0x00, 0x00, 0x00}, // 'L'
+    {0x00, 0x00, 0xe3, 0xe7, 0xe7, 0xd7, 0xdf, 0xdb, 0xc3, 0xc3, 0xc3, 0xc3, 0x00, 0x00, 0x00, 0x00}, // 'M'
+    {0x00, 0x00, 0x63, 0x63, 0x73, 0x53, 0x5b, 0x4b, 0x4f, 0x47, 0x47, 0x47, 0x00, 0x00, 0x00, 0x00}, // 'N'
+    {0x00, 0x00, 0x3c, 0x66, 0x62, 0x43, 0x43, 0x43, 0x43, 0x62, 0x66, 0x3c, 0x00, 0x00, 0x00, 0x00}, // 'O'
+    {0x00, 0x00, 0x7e, 0x66, 0x63, 0x63, 0x63, 0x7e, 0x60, 0x60, 0x60, 0x60, 0x00, 0x00, 0x00, 0x00}, // 'P'
+    {0x00, 0x00, 0x3c, 0x66, 0x62, 0x43, 0x43, 0x43, 0x43, 0x62, 0x66, 0x3c, 0x06, 0x02, 0x00, 0x00}, // 'Q'
+    {0x00, 0x00, 0x7c, 0x66, 0x42, 0x46, 0x7e, 0x6c, 0x46, 0x42, 0x43, 0x41, 0x00, 0x00, 0x00, 0x00}, // 'R'
+    {0x00, 0x00, 0x3e, 0x62, 0x40, 0x60, 0x38, 0x0e, 0x02, 0x03, 0x66, 0x7c, 0x00, 0x00, 0x00, 0x00}, // 'S'
+    {0x00, 0x00, 0xff, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x00, 0x00, 0x00, 0x00}, // 'T'
+    {0x00, 0x00, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x62, 0x66, 0x3c, 0x00, 0x00, 0x00, 0x00}, // 'U'
+    {0x00, 0x00, 0xc3, 0x43, 0x62, 0x62, 0x26, 0x26, 0x34, 0x14, 0x1c, 0x18, 0x00, 0x00, 0x00, 0x00}, // 'V'
+    {0x00, 0x00, 0xc1, 0xc1, 0xd9, 0xd9, 0x5f, 0x57, 0x77, 0x66, 0x66, 0x66, 0x00, 0x00, 0x00, 0x00}, // 'W'
+    {0x00, 0x00, 0x43, 0x62, 0x36, 0x1c, 0x18, 0x1c, 0x34, 0x26, 0x62, 0xc3, 0x00, 0x00, 0x00, 0x00}, // 'X'
+    {0x00, 0x00, 0xc3, 0x62, 0x26, 0x34, 0x1c, 0x18, 0x18, 0x18, 0x18, 0x18, 0x00, 0x00, 0x00, 0x00}, // 'Y'
+    {0x00, 0x00, 0x7f, 0x03, 0x06, 0x04, 0x0c, 0x18, 0x10, 0x30, 0x60, 0x7f, 0x00, 0x00, 0x00, 0x00}, // 'Z'
+    {0x00, 0x1c, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x1c, 0x00, 0x00}, // '['
+    {0x00, 0x00, 0x40, 0x60, 0x20, 0x30, 0x10, 0x18, 0x08, 0x0c, 0x04, 0x06, 0x06, 0x02, 0x00, 0x00}, // '\\'
+    {0x00, 0x38, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x38, 0x00, 0x00}, // ']'
+    {0x00, 0x18, 0x3c, 0x26, 0x43, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // '^'
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff}, // '_'
+    {0x20, 0x10, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // '`'
+    {0x00, 0x00, 0x00, 0x00, 0x3c, 0x26, 0x02, 0x3e, 0x62, 0x42, 0x66, 0x3a, 0x00, 0x00, 0x00, 0x00}, // 'a'
+    {0x00, 0x60, 0x60, 0x60, 0x7c, 0x76, 0x63, 0x63, 0x63, 0x63, 0x76, 0x7c, 0x00, 0x00, 0x00, 0x00}, // 'b'
+    {0x00, 0x00, 0x00, 0x00, 0x1e, 0x32, 0x60, 0x60, 0x60, 0x60, 0x32, 0x1e, 0x00, 0x00, 0x00, 0x00}, // 'c'
+    {0x00, 0x02, 0x02, 0x02, 0x3e, 0x66, 0x62, 0x42, 0x42, 0x42, 0x66, 0x3e, 0x00, 0x00, 0x00, 0x00}, // 'd'
+    {0x00, 0x00, 0x00, 0x00, 0x3c, 0x66, 0x43, 0x7f, 0x40, 0x60, 0x62, 0x3e, 0x00, 0x00, 0x00, 0x00}, // 'e'
+    {0x00, 0x0e, 0x18, 0x18, 0x7e, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x00, 0x00, 0x00, 0x00}, // 'f'
+    {0x00, 0x00, 0x00, 0x00, 0x3e, 0x66, 0x62, 0x42, 0x42, 0x62, 0x66, 0x3e, 0x02, 0x06, 0x3c, 0x00}, // 'g'
+    {0x00, 0x60, 0x60, 0x60, 0x7c, 0x76, 0x62, 0x62, 0x62, 0x62, 0x62, 0x62, 0x00, 0x00, 0x00, 0x00}, // 'h'
+    {0x00, 0x08, 0x08, 0x00, 0x38, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x7f, 0x00, 0x00, 0x00, 0x00}, // 'i'
+    {0x00, 0x08, 0x08, 0x00, 0x38, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x78, 0x00}, // 'j'
+    {0x00, 0x60, 0x60, 0x60, 0x62, 0x64, 0x68, 0x78, 0x6c, 0x66, 0x62, 0x63, 0x00, 0x00, 0x00, 0x00}, // 'k'
+    {0x00, 0x70, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x18, 0x18, 0x0e, 0x00, 0x00, 0x00, 0x00}, // 'l'
+    {0x00, 0x00, 0x00, 0x00, 0x7e, 0x5b, 0x4b, 0x4b, 0x4b, 0x4b, 0x4b, 0x4b, 0x00, 0x00, 0x00, 0x00}, // 'm'
+    {0x00, 0x00, 0x00, 0x00, 0x7c, 0x66, 0x62, 0x62, 0x62, 0x62, 0x62, 0x62, 0x00, 0x00, 0x00, 0x00}, // 'n'
+    {0x00, 0x00, 0x00, 0x00, 0x3c, 0x66, 0x62, 0x43, 0x43, 0x62, 0x66, 0x3c, 0x00, 0x00, 0x00, 0x00}, // 'o'
+    {0x00, 0x00, 0x00, 0x00, 0x7c, 0x66, 0x62, 0x63, 0x63, 0x62, 0x76, 0x7c, 0x60, 0x60, 0x60, 0x00}, // 'p'
+    {0x00, 0x00, 0x00, 0x00, 0x3e, 0x66, 0x62, 0x42, 0x42, 0x62, 0x66, 0x3e, 0x02, 0x02, 0x02, 0x00}, // 'q'
+    {0x00, 0x00, 0x00, 0x00, 0x3f, 0x38, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x00, 0x00, 0x00, 0x00}, // 'r'
+    {0x00, 0x00, 0x00, 0x00, 0x3e, 0x20, 0x60, 0x38, 0x0e, 0x02, 0x06, 0x3c, 0x00, 0x00, 0x00, 0x00}, // 's'
+    {0x00, 0x00, 0x10, 0x10, 0x7e, 0x10, 0x10, 0x10, 0x10, 0x10, 0x18, 0x0e, 0x00, 0x00, 0x00, 0x00}, // 't'
+    {0x00, 0x00, 0x00, 0x00, 0x62, 0x62, 0x62, 0x62, 0x62, 0x62, 0x66, 0x3e, 0x00, 0x00, 0x00, 0x00}, // 'u'
+    {0x00, 0x00, 0x00, 0x00, 0x43, 0x62, 0x66, 0x26, 0x34, 0x34, 0x1c, 0x18, 0x00, 0x00, 0x00, 0x00}, // 'v'
+    {0x00, 0x00, 0x00, 0x00, 0x81, 0xc1, 0xc9, 0x5b, 0x5b, 0x76, 0x76, 0x26, 0x00, 0x00, 0x00, 0x00}, // 'w'
+    {0x00, 0x00, 0x00, 0x00, 0x62, 0x26, 0x3c, 0x18, 0x18, 0x34, 0x66, 0x43, 0x00, 0x00, 0x00, 0x00}, // 'x'
+    {0x00, 0x00, 0x00, 0x00, 0x43, 0x62, 0x22, 0x26, 0x34, 0x1c, 0x1c, 0x18, 0x18, 0x10, 0x70, 0x00}, // 'y'
+    {0x00, 0x00, 0x00, 0x00, 0x7e, 0x06, 0x04, 0x08, 0x18, 0x30, 0x20, 0x7e, 0x00, 0x00, 0x00, 0x00}, // 'z'
+    {0x00, 0x0e, 0x08, 0x08, 0x08, 0x18, 0x18, 0x70, 0x18, 0x18, 0x08, 0x08, 0x08, 0x0e, 0x00, 0x00}, // '{'
+    {0x00, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08}, // '|'
+    {0x00, 0x70, 0x18, 0x18, 0x18, 0x18, 0x08, 0x0e, 0x08, 0x18, 0x18, 0x18, 0x18, 0x70, 0x00, 0x00}, // '}'
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x79, 0x4f, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // '~'
+};
+
+static constexpr int cFirstGlyph = 32;
+static constexpr int cNumGlyphs = 95;
+
+// Every glyph gets a 1 pixel border in the atlas so linear filtering never picks up its neighbours
+static constexpr int cAtlasColumns = 16;
+static constexpr int cAtlasRows = (cNumGlyphs + cAtlasColumns - 1) / cAtlasColumns;
+static constexpr int cCellWidth = TextRenderer::cGlyphWidth + 2;
+static constexpr int cCellHeight = TextRenderer::cGlyphHeight + 2;
+static constexpr int cAtlasWidth = cAtlasColumns * cCellWidth;
+static constexpr int cAtlasHeight = cAtlasRows * cCellHeight;
+
+TextRenderer::TextRenderer()
+{
+    program = build_shader_program(textVertexShaderSource, textFragmentShaderSource);
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "text"), 0);
+
+    BuildAtlas();
+
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, cFloatsPerVertex * sizeof(float), (void *)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, cFloatsPerVertex * sizeof(float), (void *)(4 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+    glBindVertexArray(0);
+}
+
+TextRenderer::~TextRenderer()
+{
+    if (!gl_context_is_alive())
+        return;
+
+    glDeleteBuffers(1, &VBO);
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteTextures(1, &atlas);
+    glDeleteProgram(program);
+}
+
+void TextRenderer::BuildAtlas()
+{
+    // Row 0 of the texture is the top row of the glyphs, texture coordinates are flipped to match in AddText
+    std::vector<unsigned char> pixels(cAtlasWidth * cAtlasHeight, 0);
+    for (int glyph = 0; glyph < cNumGlyphs; glyph++)
+    {
+        int cell_x = (glyph % cAtlasColumns) * cCellWidth + 1;
+        int cell_y = (glyph / cAtlasColumns) * cCellHeight + 1;
+        for (int row = 0; row < cGlyphHeight; row++)
+            for (int column = 0; column < cGlyphWidth; column++)
+                if (cFont8x16[glyph][row] & (0x80 >> column))
+                    pixels[(cell_y + row) * cAtlasWidth + cell_x + column] = 255;
+    }
+
+    glGenTextures(1, &atlas);
+    glBindTexture(GL_TEXTURE_2D, atlas);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, cAtlasWidth, cAtlasHeight, 0, GL_RED, GL_UNSIGNED_BYTE, pixels.data());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void TextRenderer::AddText(float x, float y, float pixelHeight, JPH::string_view text, JPH::ColorArg color)
+{
+    float scale = pixelHeight / cGlyphHeight;
+    float glyph_width = cGlyphWidth * scale;
+    float r = color.r / 255.0f, g = color.g / 255.0f, b = color.b / 255.0f;
+
+    float pen_x = x, pen_y = y;
+    for (char c : text)
+    {
+        if (c == '\n')
+        {
+            pen_x = x;
+            pen_y -= pixelHeight;
+            continue;
+        }
+
+        int glyph = (unsigned char)c - cFirstGlyph;
+        if (glyph < 0 || glyph >= cNumGlyphs)
+            glyph = '?' - cFirstGlyph;
+
+        if (glyph != 0) // nothing to draw for a space
+        {
+            float u0 = float((glyph % cAtlasColumns) * cCellWidth + 1) / cAtlasWidth;
+            float v0 = float((glyph / cAtlasColumns) * cCellHeight + 1) / cAtlasHeight;
+            float u1 = u0 + float(cGlyphWidth) / cAtlasWidth;
+            float v1 = v0 + float(cGlyphHeight) / cAtlasHeight;
+
+            float x0 = pen_x, x1 = pen_x + glyph_width;
+            float y0 = pen_y, y1 = pen_y + pixelHeight;
+
+            // Two triangles, the top of the quad samples the top of the glyph (v0)
+            const float quad[cFloatsPerGlyph] = {
+                x0, y1, u0, v0, r, g, b,
+                x0, y0, u0, v1, r, g, b,
+                x1, y0, u1, v1, r, g, b,
+                x0, y1, u0, v0, r, g, b,
+                x1, y0, u1, v1, r, g, b,
+                x1, y1, u1, v0, r, g, b,
+            };
+            vertices.insert(vertices.end(), quad, quad + cFloatsPerGlyph);
+        }
+
+        pen_x += glyph_width;
+    }
+}
+
+void TextRenderer::Flush(unsigned int viewportWidth, unsigned int viewportHeight)
+{
+    if (vertices.empty())
+        return;
+
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    // Grow with some slack so the size doesn't change every time another label shows up. The storage is
+    // orphaned every frame, so we never wait for the previous frame's draw to finish reading it.
+    size_t bytes = vertices.size() * sizeof(float);
+    if (bytes > gpuCapacity)
+        gpuCapacity = bytes + bytes / 2;
+    glBufferData(GL_ARRAY_BUFFER, gpuCapacity, nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, vertices.data());
+
+    glUseProgram(program);
+    glm::mat4 projection = glm::ortho(0.0f, float(viewportWidth), 0.0f, float(viewportHeight));
+    glUniformMatrix4fv(glGetUniformLocation(program, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, atlas);
+
+    // Text goes on top of everything, blended
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    glDisable(GL_DEPTH_TEST);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    glDrawArrays(GL_TRIANGLES, 0, GLsizei(vertices.size() / cFloatsPerVertex));
+
+    glDisable(GL_BLEND);
+    glEnable(GL_DEPTH_TEST);
+    glBindVertexArray(0);
+
+    vertices.clear();
+}
@@ -0,0 +1,50 @@
+#ifndef TEXT_RENDERER_HPP
+#define TEXT_RENDERER_HPP
+
+#include <Jolt/Jolt.h>
+#include <Jolt/Core/Color.h>
+
+#include <vector>
+
+// Screen space text, every string queued during a frame goes out in a single draw call.
+//
+// The glyphs come from a built in 8x16 bitmap font (printable ASCII) that is rasterized into an
+// atlas texture once. AddText only appends quads to a vertex array on the CPU, Flush uploads the
+// array and draws it with the shaders in text/, so thousands of labels cost one upload and one call.
+class TextRenderer {
+
+public:
+  // Needs a current GL context
+  TextRenderer();
+  ~TextRenderer();
+
+  TextRenderer(const TextRenderer &) = delete;
+  TextRenderer &operator=(const TextRenderer &) = delete;
+
+  // Queues text with the bottom left of its first line at (x, y), in pixels from the bottom left of the
+  // viewport. Lines are pixelHeight apart, characters outside printable ASCII are drawn as '?'.
+  void AddText(float x, float y, float pixelHeight, JPH::string_view text, JPH::ColorArg color);
+
+  // Draws everything queued since the last Flush on top of the frame
+  void Flush(unsigned int viewportWidth, unsigned int viewportHeight);
+
+  size_t NumQueuedGlyphs() const { return vertices.size() / cFloatsPerGlyph; }
+
+  static constexpr int cGlyphWidth = 8;
+  static constexpr int cGlyphHeight = 16;
+
+private:
+  // 6 vertices per glyph of <vec2 pos, vec2 tex, vec3 color>
+  static constexpr size_t cFloatsPerVertex = 7;
+  static constexpr size_t cFloatsPerGlyph = 6 * cFloatsPerVertex;
+
+  void BuildAtlas();
+
+  unsigned int program = 0;
+  unsigned int atlas = 0;
+  unsigned int VAO = 0, VBO = 0;
+  size_t gpuCapacity = 0;
+  std::vector<float> vertices;
+};
+
+#endif // TEXT_RENDERER_HPP
@@ -0,0 +1,94 @@
+#include "allocation_stats.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+// Every block is preceded by this header, it remembers what to pass to free and how much to uncount
+struct alignas(16) BlockHeader {
+    void *base;
+    size_t size;
+};
+
+static std::atomic<size_t> live_bytes{0};
+static std::atomic<size_t> peak_bytes{0};
+static std::atomic<size_t> num_allocations{0};
+
+static void count_allocation(size_t size)
+{
+    size_t live = live_bytes.fetch_add(size, std::memory_order_relaxed) + size;
+    num_allocations.fetch_add(1, std::memory_order_relaxed);
+
+    size_t peak = peak_bytes.load(std::memory_order_relaxed);
+    while (live > peak && !peak_bytes.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+    {
+    }
+}
+
+static void *counting_aligned_allocate(size_t size, size_t alignment)
+{
+    if (alignment < alignof(BlockHeader))
+        alignment = alignof(BlockHeader);
+
+    void *base = malloc(size + alignment + sizeof(BlockHeader));
+    if (base == nullptr)
+        return nullptr;
+
+    uintptr_t data = (reinterpret_cast<uintptr_t>(base) + sizeof(BlockHeader) + alignment - 1) & ~uintptr_t(alignment - 1);
+    BlockHeader *header = reinterpret_cast<BlockHeader *>(data) - 1;
+    header->base = base;
+    header->size = size;
+
+    count_allocation(size);
+    return reinterpret_cast<void *>(data);
+}
+
+static void counting_aligned_free(void *block)
+{
+    if (block == nullptr)
+        return;
+
+    BlockHeader *header = static_cast<BlockHeader *>(block) - 1;
+    live_bytes.fetch_sub(header->size, std::memory_order_relaxed);
+    free(header->base);
+}
+
+static void *counting_allocate(size_t size)
+{
+    return counting_aligned_allocate(size, alignof(BlockHeader));
+}
+
+static void *counting_reallocate(void *block, size_t old_size, size_t new_size)
+{
+    void *new_block = counting_allocate(new_size);
+    if (block != nullptr && new_block != nullptr)
+    {
+        memcpy(new_block, block, old_size < new_size ? old_size : new_size);
+        counting_aligned_free(block);
+    }
+    return new_block;
+}
+
+void RegisterCountingAllocator()
+{
+    JPH::Allocate = counting_allocate;
+    JPH::Reallocate = counting_reallocate;
+    JPH::Free = counting_aligned_free;
+    JPH::AlignedAllocate = counting_aligned_allocate;
+    JPH::AlignedFree = counting_aligned_free;
+}
+
+AllocationStats GetAllocationStats()
+{
+    AllocationStats stats;
+    stats.liveBytes = live_bytes.load(std::memory_order_relaxed);
+    stats.peakBytes = peak_bytes.load(std::memory_order_relaxed);
+    stats.numAllocations = num_allocations.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void ResetPeakAllocation()
+{
+    peak_bytes.store(live_bytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
@@ -0,0 +1,23 @@
+#ifndef ALLOCATION_STATS_HPP
+#define ALLOCATION_STATS_HPP
+
+#include <Jolt/Jolt.h>
+
+#include <cstddef>
+
+// Heap usage of Jolt, as seen through its allocation hooks
+struct AllocationStats {
+  size_t liveBytes;       // currently allocated
+  size_t peakBytes;       // highest liveBytes since the last ResetPeakAllocation
+  size_t numAllocations;  // allocations made since startup
+};
+
+// Use instead of JPH::RegisterDefaultAllocator() to have Jolt allocate through malloc/free while counting
+// every allocation. Costs a header per block and a few relaxed atomics per call.
+void RegisterCountingAllocator();
+
+AllocationStats GetAllocationStats();
+
+void ResetPeakAllocation();
+
+#endif // ALLOCATION_STATS_HPP
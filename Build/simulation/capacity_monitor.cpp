@@ -0,0 +1,227 @@
+#include "capacity_monitor.hpp"
+
+#include <Jolt/Physics/Body/BodyLock.h>
+#include <Jolt/Physics/Collision/BroadPhase/BroadPhaseQuery.h>
+
+#include <algorithm>
+#include <cstdio>
+
+// Smallest power of two >= value, capacities are easier to read (and to compare between runs) that way
+static JPH::uint round_up_pow2(double value)
+{
+    JPH::uint result = 1;
+    while (result < value && result < 0x80000000u)
+        result <<= 1;
+    return result;
+}
+
+CapacityMonitor::CapacityMonitor(const PhysicsCapacity &capacity, float warnFraction, JPH::uint pairSampleInterval)
+    : capacity(capacity), warnFraction(warnFraction), pairSampleInterval(pairSampleInterval)
+{
+}
+
+namespace {
+
+// Counts the bodies a query box overlaps, without the body itself and with pairs of two active bodies counted once
+class PairCounter final : public JPH::CollideShapeBodyCollector {
+
+public:
+    PairCounter(const JPH::BodyInterface &bodies, JPH::BodyID self) : bodies(bodies), self(self) {}
+
+    void AddHit(const JPH::BodyID &inBodyID) override
+    {
+        if (inBodyID == self || (inBodyID < self && bodies.IsActive(inBodyID)))
+            return;
+        count++;
+    }
+
+    JPH::uint count = 0;
+
+private:
+    const JPH::BodyInterface &bodies;
+    JPH::BodyID self;
+};
+
+} // namespace
+
+JPH::uint CapacityMonitor::CountBroadPhasePairs(const JPH::PhysicsSystem &system)
+{
+    // Same query Jolt does to fill the pair queue: the bounds of every active body against the broad phase
+    system.GetActiveBodies(JPH::EBodyType::RigidBody, activeBodies);
+    const JPH::BodyLockInterfaceNoLock &lock_interface = system.GetBodyLockInterfaceNoLock();
+    const JPH::BodyInterface &body_interface = system.GetBodyInterfaceNoLock();
+    const JPH::BroadPhaseQuery &broad_phase = system.GetBroadPhaseQuery();
+    JPH::Vec3 margin = JPH::Vec3::sReplicate(system.GetPhysicsSettings().mSpeculativeContactDistance);
+
+    JPH::uint pairs = 0;
+    for (const JPH::BodyID &id : activeBodies)
+    {
+        JPH::BodyLockRead lock(lock_interface, id);
+        if (!lock.Succeeded())
+            continue;
+        const JPH::Body &body = lock.GetBody();
+
+        JPH::AABox bounds = body.GetWorldSpaceBounds();
+        bounds.ExpandBy(margin);
+        PairCounter counter(body_interface, id);
+        broad_phase.CollideAABox(bounds, counter, system.GetDefaultBroadPhaseLayerFilter(body.GetObjectLayer()),
+                                 system.GetDefaultLayerFilter(body.GetObjectLayer()));
+        pairs += counter.count;
+    }
+    return pairs;
+}
+
+void CapacityMonitor::AfterUpdate(const JPH::PhysicsSystem &system, JPH::EPhysicsUpdateError errors, int collisionSteps)
+{
+    stats.numUpdates++;
+
+    stats.numBodies = system.GetNumBodies();
+    stats.peakBodies = std::max(stats.peakBodies, stats.numBodies);
+
+    // The contact buffer is reset every collision step, so spread what we counted over the steps
+    JPH::uint contacts = contactsThisUpdate.exchange(0, std::memory_order_relaxed);
+    stats.contactsLastUpdate = (contacts + collisionSteps - 1) / std::max(1, collisionSteps);
+    stats.peakContacts = std::max(stats.peakContacts, stats.contactsLastUpdate);
+
+    // Also count right away when the queue overflowed, that's the frame the recommendation has to cover
+    bool pairs_overflowed = (errors & JPH::EPhysicsUpdateError::BodyPairCacheFull) != JPH::EPhysicsUpdateError::None;
+    bool sample_pairs = pairSampleInterval > 0 && (pairs_overflowed || (stats.numUpdates - 1) % pairSampleInterval == 0);
+    if (sample_pairs)
+    {
+        stats.pairsLastSample = CountBroadPhasePairs(system);
+        stats.peakPairs = std::max(stats.peakPairs, stats.pairsLastSample);
+    }
+
+    if (pairs_overflowed)
+    {
+        if (stats.bodyPairOverflows++ == 0)
+            JPH::Trace("CapacityMonitor: body pair cache full at update %u (maxBodyPairs = %u), contacts are being dropped",
+                       stats.numUpdates, capacity.maxBodyPairs);
+    }
+    if ((errors & JPH::EPhysicsUpdateError::ManifoldCacheFull) != JPH::EPhysicsUpdateError::None)
+    {
+        if (stats.manifoldOverflows++ == 0)
+            JPH::Trace("CapacityMonitor: manifold cache full at update %u (maxContactConstraints = %u), contacts are being dropped",
+                       stats.numUpdates, capacity.maxContactConstraints);
+    }
+    if ((errors & JPH::EPhysicsUpdateError::ContactConstraintsFull) != JPH::EPhysicsUpdateError::None)
+    {
+        if (stats.contactOverflows++ == 0)
+            JPH::Trace("CapacityMonitor: contact constraint buffer full at update %u (maxContactConstraints = %u), bodies will interpenetrate",
+                       stats.numUpdates, capacity.maxContactConstraints);
+    }
+
+    WarnIfClose("bodies", stats.numBodies, capacity.maxBodies, warnedBodies);
+    if (sample_pairs)
+        WarnIfClose("body pairs (broad phase overlaps, estimate)", stats.pairsLastSample, capacity.maxBodyPairs, warnedPairs);
+    WarnIfClose("contact constraints", stats.contactsLastUpdate, capacity.maxContactConstraints, warnedContacts);
+}
+
+void CapacityMonitor::WarnIfClose(const char *what, JPH::uint used, JPH::uint limit, bool &warned)
+{
+    // Warn once when crossing the threshold, and again only after dropping below it
+    bool close = used >= warnFraction * limit;
+    if (close && !warned)
+        JPH::Trace("CapacityMonitor: %u %s, %.0f%% of the limit of %u", used, what, 100.0 * used / limit, limit);
+    warned = close;
+}
+
+PhysicsCapacity CapacityMonitor::Recommend(float headroom) const
+{
+    PhysicsCapacity result;
+
+    result.maxBodies = std::max(capacity.maxBodies, round_up_pow2(stats.peakBodies * headroom));
+
+    // An overflowing buffer never shows how much it really needed, at least double it. Manifolds are only a lower
+    // bound for the pairs, without pair samples assume the usual few overlapping pairs per manifold.
+    constexpr float cPairsPerManifold = 4.0f;
+    JPH::uint peak_pairs = pairSampleInterval > 0 ? std::max(stats.peakPairs, stats.peakContacts) : JPH::uint(stats.peakContacts * cPairsPerManifold);
+    result.maxBodyPairs = std::max(stats.bodyPairOverflows > 0 ? 2 * capacity.maxBodyPairs : capacity.maxBodyPairs,
+                                   round_up_pow2(peak_pairs * headroom));
+
+    bool contacts_overflowed = stats.manifoldOverflows > 0 || stats.contactOverflows > 0;
+    result.maxContactConstraints = std::max(contacts_overflowed ? 2 * capacity.maxContactConstraints : capacity.maxContactConstraints,
+                                            round_up_pow2(stats.peakContacts * headroom));
+
+    return result;
+}
+
+void CapacityMonitor::Report() const
+{
+    PhysicsCapacity recommended = Recommend();
+    JPH::Trace("CapacityMonitor: %u updates, bodies %u (peak %u / %u), contact manifolds peak %u / %u",
+               stats.numUpdates, stats.numBodies, stats.peakBodies, capacity.maxBodies, stats.peakContacts,
+               capacity.maxContactConstraints);
+    if (pairSampleInterval > 0)
+        JPH::Trace("CapacityMonitor: body pairs peak %u / %u (broad phase overlaps sampled every %u updates, at least %u from the manifolds)",
+                   stats.peakPairs, capacity.maxBodyPairs, pairSampleInterval, stats.peakContacts);
+    else
+        JPH::Trace("CapacityMonitor: body pairs at least %u / %u (lower bound from the manifolds, pair sampling is off)",
+                   stats.peakContacts, capacity.maxBodyPairs);
+    JPH::Trace("CapacityMonitor: overflows: body pairs %u, manifolds %u, contact constraints %u",
+               stats.bodyPairOverflows, stats.manifoldOverflows, stats.contactOverflows);
+    JPH::Trace("CapacityMonitor: recommended maxBodies = %u, maxBodyPairs = %u, maxContactConstraints = %u",
+               recommended.maxBodies, recommended.maxBodyPairs, recommended.maxContactConstraints);
+}
+
+bool CapacityMonitor::Load(const char *path, PhysicsCapacity &ioCapacity)
+{
+    FILE *file = fopen(path, "r");
+    if (file == nullptr)
+        return false;
+
+    PhysicsCapacity loaded;
+    bool ok = fscanf(file, "%u %u %u", &loaded.maxBodies, &loaded.maxBodyPairs, &loaded.maxContactConstraints) == 3;
+    fclose(file);
+    if (!ok)
+        return false;
+
+    ioCapacity.maxBodies = std::max(ioCapacity.maxBodies, loaded.maxBodies);
+    ioCapacity.maxBodyPairs = std::max(ioCapacity.maxBodyPairs, loaded.maxBodyPairs);
+    ioCapacity.maxContactConstraints = std::max(ioCapacity.maxContactConstraints, loaded.maxContactConstraints);
+    return true;
+}
+
+bool CapacityMonitor::SaveRecommendation(const char *path, float headroom) const
+{
+    FILE *file = fopen(path, "w");
+    if (file == nullptr)
+        return false;
+
+    PhysicsCapacity recommended = Recommend(headroom);
+    fprintf(file, "%u %u %u\n", recommended.maxBodies, recommended.maxBodyPairs, recommended.maxContactConstraints);
+    fclose(file);
+    return true;
+}
+
+JPH::ValidateResult CapacityMonitor::OnContactValidate(const JPH::Body &inBody1, const JPH::Body &inBody2, JPH::RVec3Arg inBaseOffset,
+                                                       const JPH::CollideShapeResult &inCollisionResult)
+{
+    if (forward != nullptr)
+        return forward->OnContactValidate(inBody1, inBody2, inBaseOffset, inCollisionResult);
+    return JPH::ValidateResult::AcceptAllContactsForThisBodyPair;
+}
+
+void CapacityMonitor::OnContactAdded(const JPH::Body &inBody1, const JPH::Body &inBody2, const JPH::ContactManifold &inManifold,
+                                     JPH::ContactSettings &ioSettings)
+{
+    contactsThisUpdate.fetch_add(1, std::memory_order_relaxed);
+
+    if (forward != nullptr)
+        forward->OnContactAdded(inBody1, inBody2, inManifold, ioSettings);
+}
+
+void CapacityMonitor::OnContactPersisted(const JPH::Body &inBody1, const JPH::Body &inBody2, const JPH::ContactManifold &inManifold,
+                                         JPH::ContactSettings &ioSettings)
+{
+    contactsThisUpdate.fetch_add(1, std::memory_order_relaxed);
+
+    if (forward != nullptr)
+        forward->OnContactPersisted(inBody1, inBody2, inManifold, ioSettings);
+}
+
+void CapacityMonitor::OnContactRemoved(const JPH::SubShapeIDPair &inSubShapePair)
+{
+    if (forward != nullptr)
+        forward->OnContactRemoved(inSubShapePair);
+}
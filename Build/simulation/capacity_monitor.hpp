@@ -0,0 +1,95 @@
+#ifndef CAPACITY_MONITOR_HPP
+#define CAPACITY_MONITOR_HPP
+
+#include <Jolt/Jolt.h>
+#include <Jolt/Physics/PhysicsSystem.h>
+#include <Jolt/Physics/EPhysicsUpdateError.h>
+#include <Jolt/Physics/Collision/ContactListener.h>
+
+#include <atomic>
+
+// The fixed size buffers passed to PhysicsSystem::Init
+struct PhysicsCapacity {
+  JPH::uint maxBodies;
+  JPH::uint maxBodyPairs;
+  JPH::uint maxContactConstraints;
+};
+
+struct CapacityStats {
+  JPH::uint numUpdates = 0;
+  JPH::uint numBodies = 0;
+  JPH::uint peakBodies = 0;
+  JPH::uint contactsLastUpdate = 0; // contact manifolds (= contact constraints) in the last collision step
+  JPH::uint peakContacts = 0;       // also a lower bound for the body pairs, every manifold belongs to one pair
+  JPH::uint pairsLastSample = 0;    // broad phase overlaps of the active bodies, an upper bound for the body pair queue
+  JPH::uint peakPairs = 0;
+  JPH::uint bodyPairOverflows = 0;  // updates that reported EPhysicsUpdateError::BodyPairCacheFull
+  JPH::uint manifoldOverflows = 0;  // ... ManifoldCacheFull
+  JPH::uint contactOverflows = 0;   // ... ContactConstraintsFull
+};
+
+// Watches how close a PhysicsSystem runs to the capacities it was initialized with.
+//
+// Overflows are what Update returns, and when they happen contacts are silently dropped and bodies start
+// falling through each other. Jolt doesn't expose how full its buffers are, so the monitor estimates it:
+// - contact constraints: it sits in front of the contact listener and counts the contact manifolds of
+//   every step, each one takes a contact constraint.
+// - body pairs: the pair queue holds every broad phase overlap of an active body, usually several times
+//   the number of manifolds. Every pairSampleInterval updates the monitor queries the broad phase with the
+//   bounds of all active bodies (expanded by the speculative contact distance) and counts the overlaps,
+//   which costs about as much as the broad phase part of a step. The count includes pairs Jolt filters out
+//   later, so it errs on the large side.
+// It warns through JPH::Trace on the first overflow of each kind and when usage gets close to a limit (a
+// full pair queue makes broad phase jobs do narrow phase work, which is slower but not reported as an error).
+class CapacityMonitor final : public JPH::ContactListener {
+
+public:
+  // pairSampleInterval = 0 turns off counting the body pairs, the manifold count is then the only (too low) estimate
+  explicit CapacityMonitor(const PhysicsCapacity &capacity, float warnFraction = 0.8f, JPH::uint pairSampleInterval = 30);
+
+  // Contact callbacks are passed on to this listener after being counted
+  void SetForwardListener(JPH::ContactListener *listener) { forward = listener; }
+
+  // Call after every PhysicsSystem::Update with what it returned
+  void AfterUpdate(const JPH::PhysicsSystem &system, JPH::EPhysicsUpdateError errors, int collisionSteps = 1);
+
+  const CapacityStats &GetStats() const { return stats; }
+  bool HasOverflowed() const { return stats.bodyPairOverflows + stats.manifoldOverflows + stats.contactOverflows > 0; }
+
+  // Capacities that fit the high-water marks with some headroom, never smaller than the current ones and
+  // doubled for every buffer that overflowed. Pass to PhysicsSystem::Init when the world is rebuilt.
+  PhysicsCapacity Recommend(float headroom = 1.5f) const;
+
+  // Prints the stats and the recommendation through JPH::Trace
+  void Report() const;
+
+  // Recommendations can be kept between runs, so the next run starts with buffers that are large enough.
+  // Load only ever grows ioCapacity.
+  static bool Load(const char *path, PhysicsCapacity &ioCapacity);
+  bool SaveRecommendation(const char *path, float headroom = 1.5f) const;
+
+  // See: ContactListener, called from physics jobs
+  JPH::ValidateResult OnContactValidate(const JPH::Body &inBody1, const JPH::Body &inBody2, JPH::RVec3Arg inBaseOffset,
+                                        const JPH::CollideShapeResult &inCollisionResult) override;
+  void OnContactAdded(const JPH::Body &inBody1, const JPH::Body &inBody2, const JPH::ContactManifold &inManifold,
+                      JPH::ContactSettings &ioSettings) override;
+  void OnContactPersisted(const JPH::Body &inBody1, const JPH::Body &inBody2, const JPH::ContactManifold &inManifold,
+                          JPH::ContactSettings &ioSettings) override;
+  void OnContactRemoved(const JPH::SubShapeIDPair &inSubShapePair) override;
+
+private:
+  void WarnIfClose(const char *what, JPH::uint used, JPH::uint limit, bool &warned);
+  JPH::uint CountBroadPhasePairs(const JPH::PhysicsSystem &system);
+
+  PhysicsCapacity capacity;
+  float warnFraction;
+  JPH::uint pairSampleInterval;
+  JPH::BodyIDVector activeBodies;
+  JPH::ContactListener *forward = nullptr;
+
+  std::atomic<JPH::uint> contactsThisUpdate{0};
+  CapacityStats stats;
+  bool warnedBodies = false, warnedPairs = false, warnedContacts = false;
+};
+
+#endif // CAPACITY_MONITOR_HPP
@@ -0,0 +1,122 @@
+#include "query_batch.hpp"
+
+#include <Jolt/Physics/Collision/CastResult.h>
+#include <Jolt/Physics/Collision/CollisionCollectorImpl.h>
+
+#include <algorithm>
+#include <cfloat>
+
+void RayBatchResults::Resize(size_t count)
+{
+    bodyID.resize(count);
+    subShapeID.resize(count);
+    fraction.resize(count);
+}
+
+void ShapeCastBatchResults::Resize(size_t count)
+{
+    bodyID.resize(count);
+    fraction.resize(count);
+    contactPoint.resize(count);
+    penetrationAxis.resize(count);
+}
+
+QueryBatch::QueryBatch(JPH::JobSystem &jobSystem, unsigned int minChunkSize)
+    : jobSystem(jobSystem), minChunkSize(std::max(1u, minChunkSize))
+{
+}
+
+template <class Function> void QueryBatch::ParallelFor(const char *name, size_t count, const Function &function)
+{
+    if (count == 0)
+        return;
+
+    // A few chunks per thread so threads that finish early can pick up more work,
+    // but never so many that we run out of jobs in the pool
+    size_t max_chunks = size_t(std::max(1, jobSystem.GetMaxConcurrency())) * 4;
+    size_t chunk_size = std::max<size_t>(minChunkSize, (count + max_chunks - 1) / max_chunks);
+
+    if (chunk_size >= count)
+    {
+        function(size_t(0), count);
+        return;
+    }
+
+    JPH::JobSystem::Barrier *barrier = jobSystem.CreateBarrier();
+    for (size_t begin = 0; begin < count; begin += chunk_size)
+    {
+        size_t end = std::min(begin + chunk_size, count);
+        JPH::JobHandle handle = jobSystem.CreateJob(name, JPH::Color::sGreen, [&function, begin, end]() { function(begin, end); });
+        barrier->AddJob(handle);
+    }
+
+    // The calling thread helps executing the jobs while it waits
+    jobSystem.WaitForJobs(barrier);
+    jobSystem.DestroyBarrier(barrier);
+}
+
+void QueryBatch::CastRays(const JPH::NarrowPhaseQuery &query, const JPH::RRayCast *rays, size_t count,
+                          RayBatchResults &results, const JPH::BroadPhaseLayerFilter &broadPhaseLayerFilter,
+                          const JPH::ObjectLayerFilter &objectLayerFilter, const JPH::BodyFilter &bodyFilter)
+{
+    JPH_ASSERT(results.Size() >= count);
+
+    JPH::BodyID *body_ids = results.bodyID.data();
+    JPH::SubShapeID *sub_shape_ids = results.subShapeID.data();
+    float *fractions = results.fraction.data();
+
+    ParallelFor("CastRays", count, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++)
+        {
+            JPH::RayCastResult hit;
+            if (query.CastRay(rays[i], hit, broadPhaseLayerFilter, objectLayerFilter, bodyFilter))
+            {
+                body_ids[i] = hit.mBodyID;
+                sub_shape_ids[i] = hit.mSubShapeID2;
+                fractions[i] = hit.mFraction;
+            }
+            else
+            {
+                body_ids[i] = JPH::BodyID();
+                sub_shape_ids[i] = JPH::SubShapeID();
+                fractions[i] = 1.0f + FLT_EPSILON;
+            }
+        }
+    });
+}
+
+void QueryBatch::CastShapes(const JPH::NarrowPhaseQuery &query, const JPH::RShapeCast *casts, size_t count,
+                            const JPH::ShapeCastSettings &settings, JPH::RVec3Arg baseOffset,
+                            ShapeCastBatchResults &results, const JPH::BroadPhaseLayerFilter &broadPhaseLayerFilter,
+                            const JPH::ObjectLayerFilter &objectLayerFilter, const JPH::BodyFilter &bodyFilter)
+{
+    JPH_ASSERT(results.Size() >= count);
+
+    JPH::RVec3 base_offset = baseOffset;
+    JPH::BodyID *body_ids = results.bodyID.data();
+    float *fractions = results.fraction.data();
+    JPH::Vec3 *contact_points = results.contactPoint.data();
+    JPH::Vec3 *penetration_axes = results.penetrationAxis.data();
+
+    ParallelFor("CastShapes", count, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++)
+        {
+            JPH::ClosestHitCollisionCollector<JPH::CastShapeCollector> collector;
+            query.CastShape(casts[i], settings, base_offset, collector, broadPhaseLayerFilter, objectLayerFilter, bodyFilter);
+            if (collector.HadHit())
+            {
+                body_ids[i] = collector.mHit.mBodyID2;
+                fractions[i] = collector.mHit.mFraction;
+                contact_points[i] = collector.mHit.mContactPointOn2;
+                penetration_axes[i] = collector.mHit.mPenetrationAxis;
+            }
+            else
+            {
+                body_ids[i] = JPH::BodyID();
+                fractions[i] = 1.0f + FLT_EPSILON;
+                contact_points[i] = JPH::Vec3::sZero();
+                penetration_axes[i] = JPH::Vec3::sZero();
+            }
+        }
+    });
+}
@@ -0,0 +1,67 @@
+#ifndef QUERY_BATCH_HPP
+#define QUERY_BATCH_HPP
+
+#include <Jolt/Jolt.h>
+#include <Jolt/Core/JobSystem.h>
+#include <Jolt/Physics/Body/BodyID.h>
+#include <Jolt/Physics/Collision/NarrowPhaseQuery.h>
+#include <Jolt/Physics/Collision/RayCast.h>
+#include <Jolt/Physics/Collision/ShapeCast.h>
+
+#include <vector>
+
+// Closest hit of every ray in a batch, one array per field so consumers only touch what they read.
+// A ray that hit nothing has an invalid body ID and a fraction of 1 + FLT_EPSILON.
+struct RayBatchResults {
+  std::vector<JPH::BodyID> bodyID;
+  std::vector<JPH::SubShapeID> subShapeID;
+  std::vector<float> fraction;
+
+  void Resize(size_t count);
+  size_t Size() const { return fraction.size(); }
+};
+
+// Closest hit of every shape cast in a batch, positions are relative to the base offset of the cast
+struct ShapeCastBatchResults {
+  std::vector<JPH::BodyID> bodyID;
+  std::vector<float> fraction;
+  std::vector<JPH::Vec3> contactPoint;
+  std::vector<JPH::Vec3> penetrationAxis;
+
+  void Resize(size_t count);
+  size_t Size() const { return fraction.size(); }
+};
+
+// Runs large numbers of ray and shape casts in parallel on a job system.
+//
+// The queries are cut into contiguous chunks, one job per chunk, and every job writes straight
+// into its own range of the preallocated result arrays so nothing is shared between jobs.
+// Meant to run between PhysicsSystem::Update calls with PhysicsSystem::GetNarrowPhaseQueryNoLock():
+// nothing modifies bodies at that point, so the casts don't need to take body locks.
+// The filters are called from several threads at once and must be thread safe.
+class QueryBatch {
+
+public:
+  // minChunkSize keeps the per-job overhead small for tiny batches
+  explicit QueryBatch(JPH::JobSystem &jobSystem, unsigned int minChunkSize = 64);
+
+  // results must have been resized to at least count
+  void CastRays(const JPH::NarrowPhaseQuery &query, const JPH::RRayCast *rays, size_t count, RayBatchResults &results,
+                const JPH::BroadPhaseLayerFilter &broadPhaseLayerFilter = {},
+                const JPH::ObjectLayerFilter &objectLayerFilter = {}, const JPH::BodyFilter &bodyFilter = {});
+
+  // results must have been resized to at least count
+  void CastShapes(const JPH::NarrowPhaseQuery &query, const JPH::RShapeCast *casts, size_t count,
+                  const JPH::ShapeCastSettings &settings, JPH::RVec3Arg baseOffset, ShapeCastBatchResults &results,
+                  const JPH::BroadPhaseLayerFilter &broadPhaseLayerFilter = {},
+                  const JPH::ObjectLayerFilter &objectLayerFilter = {}, const JPH::BodyFilter &bodyFilter = {});
+
+private:
+  // Calls function(begin, end) for every chunk of [0, count) on the job system and waits for all of them
+  template <class Function> void ParallelFor(const char *name, size_t count, const Function &function);
+
+  JPH::JobSystem &jobSystem;
+  unsigned int minChunkSize;
+};
+
+#endif // QUERY_BATCH_HPP
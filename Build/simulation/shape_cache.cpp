@@ -0,0 +1,358 @@
+#include "shape_cache.hpp"
+
+#include <Jolt/Core/StreamIn.h>
+#include <Jolt/Core/StreamOut.h>
+
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Bump when the layout of the file changes
+static constexpr JPH::uint32 cFormatVersion = 1;
+static constexpr char cMagic[4] = {'J', 'S', 'H', 'C'};
+
+struct CacheFileHeader {
+    char magic[4];
+    JPH::uint32 formatVersion;
+    JPH::uint32 joltVersion;
+    JPH::uint32 buildFlags;
+    JPH::uint64 sourceHash;
+    JPH::uint64 payloadSize;
+};
+
+// The binary state of a shape depends on the Jolt version and on these build options
+static JPH::uint32 build_flags()
+{
+    JPH::uint32 flags = 0;
+#ifdef JPH_DOUBLE_PRECISION
+    flags |= 1;
+#endif
+#ifdef JPH_CROSS_PLATFORM_DETERMINISTIC
+    flags |= 2;
+#endif
+    return flags;
+}
+
+static CacheFileHeader make_header(JPH::uint64 sourceHash, JPH::uint64 payloadSize)
+{
+    CacheFileHeader header;
+    memcpy(header.magic, cMagic, sizeof(cMagic));
+    header.formatVersion = cFormatVersion;
+    header.joltVersion = (JPH_VERSION_MAJOR << 16) | (JPH_VERSION_MINOR << 8) | JPH_VERSION_PATCH;
+    header.buildFlags = build_flags();
+    header.sourceHash = sourceHash;
+    header.payloadSize = payloadSize;
+    return header;
+}
+
+// Read only view of a whole file
+class MappedFile {
+
+public:
+    explicit MappedFile(const std::string &path)
+    {
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return;
+        LARGE_INTEGER file_size;
+        if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0)
+            return;
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping == nullptr)
+            return;
+        data = static_cast<const unsigned char *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        if (data != nullptr)
+            size = size_t(file_size.QuadPart);
+#else
+        fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return;
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size == 0)
+            return;
+        void *mapped = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED)
+            return;
+        // The shape is restored front to back, let the kernel read ahead
+        madvise(mapped, size_t(info.st_size), MADV_SEQUENTIAL);
+        data = static_cast<const unsigned char *>(mapped);
+        size = size_t(info.st_size);
+#endif
+    }
+
+    ~MappedFile()
+    {
+#ifdef _WIN32
+        if (data != nullptr)
+            UnmapViewOfFile(data);
+        if (mapping != nullptr)
+            CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE)
+            CloseHandle(file);
+#else
+        if (data != nullptr)
+            munmap(const_cast<unsigned char *>(data), size);
+        if (fd >= 0)
+            close(fd);
+#endif
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    const unsigned char *Data() const { return data; }
+    size_t Size() const { return size; }
+
+private:
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#else
+    int fd = -1;
+#endif
+    const unsigned char *data = nullptr;
+    size_t size = 0;
+};
+
+// Reads straight from memory, e.g. a mapped file, without buffering
+class MemoryStreamIn final : public JPH::StreamIn {
+
+public:
+    MemoryStreamIn(const unsigned char *data, size_t size) : data(data), size(size) {}
+
+    void ReadBytes(void *outData, size_t inNumBytes) override
+    {
+        if (inNumBytes > size - position)
+        {
+            memset(outData, 0, inNumBytes);
+            position = size;
+            failed = true;
+            return;
+        }
+        memcpy(outData, data + position, inNumBytes);
+        position += inNumBytes;
+    }
+
+    bool IsEOF() const override { return position >= size; }
+    bool IsFailed() const override { return failed; }
+
+private:
+    const unsigned char *data;
+    size_t size;
+    size_t position = 0;
+    bool failed = false;
+};
+
+class FileStreamOut final : public JPH::StreamOut {
+
+public:
+    explicit FileStreamOut(FILE *file) : file(file) {}
+
+    void WriteBytes(const void *inData, size_t inNumBytes) override
+    {
+        if (fwrite(inData, 1, inNumBytes, file) != inNumBytes)
+            failed = true;
+        written += inNumBytes;
+    }
+
+    bool IsFailed() const override { return failed; }
+
+    // Counted here rather than with ftell, whose long is 32-bit on Windows
+    JPH::uint64 Written() const { return written; }
+
+private:
+    FILE *file;
+    JPH::uint64 written = 0;
+    bool failed = false;
+};
+
+static double ms_since(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+ShapeCache::ShapeCache(const std::string &directory) : directory(directory)
+{
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (error)
+        JPH::Trace("ShapeCache: could not create %s: %s", directory.c_str(), error.message().c_str());
+}
+
+std::string ShapeCache::PathFor(const std::string &key) const
+{
+    // Keys become file names, keep them portable
+    std::string name = key;
+    for (char &c : name)
+        if (!isalnum((unsigned char)c) && c != '-' && c != '_' && c != '.')
+            c = '_';
+    return (std::filesystem::path(directory) / (name + ".jshape")).string();
+}
+
+// Creates a new file next to path that no other thread or process writes to. Several processes can share a cache
+// directory, so the name holds the process id and a counter, and the file is created exclusively: a file left
+// behind by a crashed process with the same id is skipped instead of written to.
+static FILE *create_temp_file(const std::string &path, std::string &outTempPath)
+{
+    static std::atomic<JPH::uint32> counter{0};
+#ifdef _WIN32
+    unsigned long pid = GetCurrentProcessId();
+#else
+    unsigned long pid = (unsigned long)getpid();
+#endif
+
+    for (int attempt = 0; attempt < 16; attempt++)
+    {
+        outTempPath = path + "." + std::to_string(pid) + "." + std::to_string(counter.fetch_add(1)) + ".tmp";
+#ifdef _WIN32
+        HANDLE handle = CreateFileA(outTempPath.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (handle == INVALID_HANDLE_VALUE)
+        {
+            if (GetLastError() == ERROR_FILE_EXISTS)
+                continue;
+            return nullptr;
+        }
+        int fd = _open_osfhandle(intptr_t(handle), _O_WRONLY | _O_BINARY);
+        if (fd == -1)
+        {
+            CloseHandle(handle);
+            DeleteFileA(outTempPath.c_str());
+            return nullptr;
+        }
+        FILE *file = _fdopen(fd, "wb");
+        if (file == nullptr)
+            _close(fd);
+#else
+        int fd = open(outTempPath.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+        if (fd == -1)
+        {
+            if (errno == EEXIST)
+                continue;
+            return nullptr;
+        }
+        FILE *file = fdopen(fd, "wb");
+        if (file == nullptr)
+            close(fd);
+#endif
+        if (file == nullptr)
+            remove(outTempPath.c_str());
+        return file;
+    }
+    return nullptr;
+}
+
+bool ShapeCache::Save(const std::string &path, const JPH::Shape &shape, JPH::uint64 sourceHash)
+{
+    // Write next to the final file and rename, so readers never see a half written file
+    std::string temp_path;
+    FILE *file = create_temp_file(path, temp_path);
+    if (file == nullptr)
+        return false;
+
+    // Header first with the size still unknown, filled in once the shape is written
+    CacheFileHeader header = make_header(sourceHash, 0);
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+
+    FileStreamOut stream(file);
+    JPH::Shape::ShapeToIDMap shape_map;
+    JPH::Shape::MaterialToIDMap material_map;
+    shape.SaveWithChildren(stream, shape_map, material_map);
+    ok = ok && !stream.IsFailed();
+
+    header.payloadSize = stream.Written();
+    ok = ok && fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, file) == 1;
+    ok = (fclose(file) == 0) && ok;
+
+    std::error_code error;
+    if (ok)
+        std::filesystem::rename(temp_path, path, error);
+    if (!ok || error)
+    {
+        std::filesystem::remove(temp_path, error);
+        return false;
+    }
+    return true;
+}
+
+JPH::ShapeRefC ShapeCache::Load(const std::string &path, JPH::uint64 sourceHash)
+{
+    MappedFile file(path);
+    if (file.Data() == nullptr || file.Size() < sizeof(CacheFileHeader))
+        return nullptr;
+
+    // The mapping is only page aligned for the start of the file, copy the header out instead of casting
+    CacheFileHeader header;
+    memcpy(&header, file.Data(), sizeof(header));
+    CacheFileHeader expected = make_header(sourceHash, file.Size() - sizeof(header));
+    if (memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0 || header.formatVersion != expected.formatVersion
+        || header.joltVersion != expected.joltVersion || header.buildFlags != expected.buildFlags
+        || header.sourceHash != expected.sourceHash || header.payloadSize != expected.payloadSize)
+        return nullptr;
+
+    MemoryStreamIn stream(file.Data() + sizeof(header), size_t(header.payloadSize));
+    JPH::Shape::IDToShapeMap shape_map;
+    JPH::Shape::IDToMaterialMap material_map;
+    JPH::Shape::ShapeResult result = JPH::Shape::sRestoreWithChildren(stream, shape_map, material_map);
+    if (stream.IsFailed() || result.HasError())
+    {
+        JPH::Trace("ShapeCache: %s is corrupt%s%s", path.c_str(), result.HasError() ? ": " : "",
+                   result.HasError() ? result.GetError().c_str() : "");
+        return nullptr;
+    }
+    return result.Get();
+}
+
+JPH::ShapeRefC ShapeCache::GetOrCook(const std::string &key, JPH::uint64 sourceHash, const JPH::ShapeSettings &settings)
+{
+    std::string path = PathFor(key);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    JPH::ShapeRefC shape = Load(path, sourceHash);
+    if (shape != nullptr)
+    {
+        stats.loadMs += ms_since(start);
+        stats.hits++;
+        return shape;
+    }
+
+    stats.misses++;
+    start = std::chrono::steady_clock::now();
+    JPH::ShapeSettings::ShapeResult result = settings.Create();
+    stats.cookMs += ms_since(start);
+    if (result.HasError())
+    {
+        JPH::Trace("ShapeCache: cooking %s failed: %s", key.c_str(), result.GetError().c_str());
+        return nullptr;
+    }
+
+    start = std::chrono::steady_clock::now();
+    if (!Save(path, *result.Get(), sourceHash))
+        JPH::Trace("ShapeCache: could not write %s", path.c_str());
+    stats.saveMs += ms_since(start);
+
+    return result.Get();
+}
+
+void ShapeCache::Report() const
+{
+    JPH::Trace("ShapeCache: %u shapes cooked in %.1f ms (+%.1f ms saving), %u loaded in %.1f ms", stats.misses,
+               stats.cookMs, stats.saveMs, stats.hits, stats.loadMs);
+}
@@ -0,0 +1,51 @@
+#ifndef SHAPE_CACHE_HPP
+#define SHAPE_CACHE_HPP
+
+#include <Jolt/Jolt.h>
+#include <Jolt/Physics/Collision/Shape/Shape.h>
+
+#include <string>
+
+struct ShapeCacheStats {
+  unsigned int hits = 0;
+  unsigned int misses = 0; // shapes that had to be cooked
+  double cookMs = 0.0;     // time spent in ShapeSettings::Create
+  double saveMs = 0.0;
+  double loadMs = 0.0;     // time spent restoring shapes from the cache, including mapping the files
+};
+
+// On-disk cache of cooked shapes, so mesh and height field worlds don't have to be rebuilt on every start.
+//
+// Every shape is stored in its own file in the cache directory, written with Shape::SaveWithChildren (so
+// shapes shared between compound children and their materials are stored once). Loading maps the file
+// into memory and restores the shape straight from the mapped pages, the only copy is the one into the
+// shape itself. A file header holds a format version, the Jolt version and build flags, and a hash of
+// the source data; any mismatch counts as a miss, the shape is cooked again and the file replaced.
+// Files are written to a temporary name and renamed, so several processes can share a cache directory.
+class ShapeCache {
+
+public:
+  explicit ShapeCache(const std::string &directory);
+
+  // Returns the shape stored under key, or cooks settings and stores the result when the cache has no valid
+  // entry. sourceHash should change whenever the data the settings were built from changes (see HashBytes
+  // in Jolt/Core/HashCombine.h). Returns nullptr and traces the error when cooking fails.
+  JPH::ShapeRefC GetOrCook(const std::string &key, JPH::uint64 sourceHash, const JPH::ShapeSettings &settings);
+
+  // Direct access to the cache files, Load returns nullptr when the file is missing, stale or corrupt
+  static bool Save(const std::string &path, const JPH::Shape &shape, JPH::uint64 sourceHash);
+  static JPH::ShapeRefC Load(const std::string &path, JPH::uint64 sourceHash);
+
+  const ShapeCacheStats &GetStats() const { return stats; }
+
+  // Prints cook time against load time through JPH::Trace
+  void Report() const;
+
+private:
+  std::string PathFor(const std::string &key) const;
+
+  std::string directory;
+  ShapeCacheStats stats;
+};
+
+#endif // SHAPE_CACHE_HPP
@@ -0,0 +1,84 @@
+#include "step_logic.hpp"
+
+#include <algorithm>
+
+void StepLogicScheduler::Chunk::OnStep(const JPH::PhysicsStepListenerContext &inContext)
+{
+    logic.UpdateBodies(inContext, inContext.mPhysicsSystem->GetBodyInterfaceNoLock(), begin, end);
+}
+
+StepLogicScheduler::StepLogicScheduler(JPH::PhysicsSystem &system, int maxConcurrency, unsigned int minChunkSize)
+    : system(system), maxConcurrency(std::max(1, maxConcurrency)), minChunkSize(std::max(1u, minChunkSize))
+{
+}
+
+StepLogicScheduler::~StepLogicScheduler()
+{
+    RemoveChunks(nullptr);
+    for (JPH::PhysicsStepListener *listener : systemLogic)
+        system.RemoveStepListener(listener);
+}
+
+void StepLogicScheduler::AddChunks(BodyLogic &logic)
+{
+    size_t count = logic.GetNumBodies();
+    if (count == 0)
+        return;
+
+    // Jolt hands out the listeners in batches, one batch per job. Make enough chunks for every thread to get a
+    // few batches so threads that finish early can pick up more work.
+    size_t batch_size = size_t(std::max(1, system.GetPhysicsSettings().mStepListenersBatchSize));
+    size_t max_chunks = size_t(maxConcurrency) * batch_size * 4;
+    size_t chunk_size = std::max<size_t>(minChunkSize, (count + max_chunks - 1) / max_chunks);
+
+    for (size_t begin = 0; begin < count; begin += chunk_size)
+    {
+        chunks.push_back(std::make_unique<Chunk>(logic, begin, std::min(begin + chunk_size, count)));
+        system.AddStepListener(chunks.back().get());
+    }
+}
+
+void StepLogicScheduler::RemoveChunks(BodyLogic *logic)
+{
+    // nullptr removes the chunks of all logic
+    auto keep = std::stable_partition(chunks.begin(), chunks.end(), [logic](const std::unique_ptr<Chunk> &chunk) {
+        return logic != nullptr && &chunk->logic != logic;
+    });
+    for (auto chunk = keep; chunk != chunks.end(); ++chunk)
+        system.RemoveStepListener(chunk->get());
+    chunks.erase(keep, chunks.end());
+}
+
+void StepLogicScheduler::AddBodyLogic(BodyLogic &logic)
+{
+    bodyLogic.push_back(&logic);
+    AddChunks(logic);
+}
+
+void StepLogicScheduler::AddSystemLogic(JPH::PhysicsStepListener &listener)
+{
+    systemLogic.push_back(&listener);
+    system.AddStepListener(&listener);
+}
+
+void StepLogicScheduler::RemoveBodyLogic(BodyLogic &logic)
+{
+    RemoveChunks(&logic);
+    bodyLogic.erase(std::remove(bodyLogic.begin(), bodyLogic.end(), &logic), bodyLogic.end());
+}
+
+void StepLogicScheduler::RemoveSystemLogic(JPH::PhysicsStepListener &listener)
+{
+    auto it = std::find(systemLogic.begin(), systemLogic.end(), &listener);
+    if (it == systemLogic.end())
+        return;
+    system.RemoveStepListener(&listener);
+    systemLogic.erase(it);
+}
+
+void StepLogicScheduler::Rebuild()
+{
+    RemoveChunks(nullptr);
+    for (BodyLogic *logic : bodyLogic)
+        AddChunks(*logic);
+}
@@ -0,0 +1,83 @@
+#ifndef STEP_LOGIC_HPP
+#define STEP_LOGIC_HPP
+
+#include <Jolt/Jolt.h>
+#include <Jolt/Physics/PhysicsSystem.h>
+#include <Jolt/Physics/PhysicsStepListener.h>
+#include <Jolt/Physics/Body/BodyInterface.h>
+
+#include <memory>
+#include <vector>
+
+// Logic that runs on a fixed set of bodies every physics step, e.g. thousands of controllers applying forces.
+//
+// The bodies are cut into contiguous ranges and every range is updated on its own job, so UpdateBodies is
+// called from several threads at once but never for the same body twice in a step. Keep the bodies (and
+// any per-body state) in arrays sorted by BodyID::GetIndex(), then every job walks memory front to back.
+// Runs while Jolt holds all body locks, which is why the body interface passed in is the non-locking one.
+// Velocities and forces can be changed, positions only read (the broad phase is updated at the same time).
+class BodyLogic {
+
+public:
+  virtual ~BodyLogic() = default;
+
+  virtual size_t GetNumBodies() const = 0;
+
+  // Updates bodies [begin, end) of this logic
+  virtual void UpdateBodies(const JPH::PhysicsStepListenerContext &context, JPH::BodyInterface &bodyInterface,
+                            size_t begin, size_t end) = 0;
+};
+
+// Runs BodyLogic inside PhysicsSystem::Update instead of serially in the main loop between updates.
+//
+// Every chunk of bodies is registered as a PhysicsStepListener. Jolt already spreads step listeners over
+// jobs (PhysicsSettings::mStepListenersBatchSize listeners per batch) before the collision step starts,
+// so the logic keeps the worker threads busy instead of leaving them idle while the main thread runs it.
+// Logic that doesn't work on bodies can be added as a plain PhysicsStepListener with AddSystemLogic.
+// Step listeners are not called when there are no active bodies.
+class StepLogicScheduler {
+
+public:
+  // minChunkSize keeps the per-listener overhead small for logic with few bodies
+  StepLogicScheduler(JPH::PhysicsSystem &system, int maxConcurrency, unsigned int minChunkSize = 64);
+  ~StepLogicScheduler();
+
+  StepLogicScheduler(const StepLogicScheduler &) = delete;
+  StepLogicScheduler &operator=(const StepLogicScheduler &) = delete;
+
+  // The number of bodies is read here, call Rebuild when it changes. Not thread safe, call between updates.
+  void AddBodyLogic(BodyLogic &logic);
+  void AddSystemLogic(JPH::PhysicsStepListener &listener);
+  void RemoveBodyLogic(BodyLogic &logic);
+  void RemoveSystemLogic(JPH::PhysicsStepListener &listener);
+
+  // Cuts all body logic into chunks again
+  void Rebuild();
+
+  size_t NumChunks() const { return chunks.size(); }
+
+private:
+  class Chunk final : public JPH::PhysicsStepListener {
+
+  public:
+    Chunk(BodyLogic &logic, size_t begin, size_t end) : logic(logic), begin(begin), end(end) {}
+
+    void OnStep(const JPH::PhysicsStepListenerContext &inContext) override;
+
+    BodyLogic &logic;
+    size_t begin;
+    size_t end;
+  };
+
+  void AddChunks(BodyLogic &logic);
+  void RemoveChunks(BodyLogic *logic);
+
+  JPH::PhysicsSystem &system;
+  int maxConcurrency;
+  unsigned int minChunkSize;
+  std::vector<BodyLogic *> bodyLogic;
+  std::vector<JPH::PhysicsStepListener *> systemLogic;
+  std::vector<std::unique_ptr<Chunk>> chunks;
+};
+
+#endif // STEP_LOGIC_HPP
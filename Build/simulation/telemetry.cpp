@@ -0,0 +1,299 @@
+#include "telemetry.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <new>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+// Bump when TelemetrySample or the layout below changes
+static constexpr JPH::uint32 cTelemetryMagic = 0x4a54454c; // "JTEL"
+static constexpr JPH::uint32 cTelemetryVersion = 2;
+
+static_assert(std::atomic<JPH::uint64>::is_always_lock_free, "the ring is shared between processes, atomics can't use locks");
+
+struct TelemetrySlot {
+    // 2 * index + 1 while sample index is being written, 2 * index + 2 once it's complete
+    std::atomic<JPH::uint64> sequence;
+    TelemetrySample sample;
+};
+
+struct TelemetryRing {
+    std::atomic<JPH::uint32> magic; // written last, a reader never sees a half initialized ring
+    JPH::uint32 version;
+    JPH::uint32 sampleSize;
+    JPH::uint32 capacity;
+    JPH::uint64 session; // changes with every publisher
+    JPH::int32 publisher; // process id of the publisher, tells a live ring from one left behind by a crash
+    std::atomic<JPH::uint32> closed;
+    std::atomic<JPH::uint64> written; // number of samples published
+    TelemetrySlot slots[1];           // capacity slots
+
+    static size_t SizeFor(JPH::uint32 capacity) { return offsetof(TelemetryRing, slots) + capacity * sizeof(TelemetrySlot); }
+};
+
+#ifndef _WIN32
+
+// Removes the ring an earlier publisher left behind (e.g. after a crash) and marks it closed so its readers let
+// go of it. Returns false without touching it when its publisher is still running.
+static bool remove_stale_ring(const char *name)
+{
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0)
+        return true;
+    struct stat info;
+    if (fstat(fd, &info) == 0 && size_t(info.st_size) >= offsetof(TelemetryRing, slots))
+    {
+        void *mapped = mmap(nullptr, size_t(info.st_size), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (mapped != MAP_FAILED)
+        {
+            // A ring of another version can't tell us its publisher, treat it as stale
+            TelemetryRing *ring = static_cast<TelemetryRing *>(mapped);
+            if (ring->magic.load(std::memory_order_acquire) == cTelemetryMagic)
+            {
+                if (ring->version == cTelemetryVersion && ring->closed.load(std::memory_order_acquire) == 0)
+                {
+                    // EPERM: the process exists but belongs to another user
+                    pid_t pid = pid_t(ring->publisher);
+                    if (pid > 0 && (kill(pid, 0) == 0 || errno == EPERM))
+                    {
+                        JPH::Trace("Telemetry: %s is in use by process %d", name, int(pid));
+                        munmap(mapped, size_t(info.st_size));
+                        close(fd);
+                        return false;
+                    }
+                }
+                ring->closed.store(1, std::memory_order_release);
+            }
+            munmap(mapped, size_t(info.st_size));
+        }
+    }
+    close(fd);
+    shm_unlink(name);
+    return true;
+}
+
+bool TelemetryPublisher::Open(const char *name, JPH::uint32 capacity)
+{
+    Close();
+    capacity = capacity < 2 ? 2 : capacity;
+
+    if (!remove_stale_ring(name))
+        return false;
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0)
+    {
+        JPH::Trace("Telemetry: shm_open(%s) failed", name);
+        return false;
+    }
+
+    size_t size = TelemetryRing::SizeFor(capacity);
+    void *mapped = MAP_FAILED;
+    if (ftruncate(fd, off_t(size)) == 0)
+        mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED)
+    {
+        JPH::Trace("Telemetry: could not map %zu bytes for %s", size, name);
+        shm_unlink(name);
+        return false;
+    }
+
+    // ftruncate zero fills, so every sequence starts out as "never written"
+    ring = new (mapped) TelemetryRing;
+    ring->version = cTelemetryVersion;
+    ring->sampleSize = sizeof(TelemetrySample);
+    ring->capacity = capacity;
+    ring->session = JPH::uint64(std::chrono::system_clock::now().time_since_epoch().count()) ^ JPH::uint64(getpid());
+    ring->publisher = JPH::int32(getpid());
+    ring->closed.store(0, std::memory_order_relaxed);
+    ring->written.store(0, std::memory_order_relaxed);
+    ring->magic.store(cTelemetryMagic, std::memory_order_release);
+
+    mappedSize = size;
+    this->name = name;
+    written = 0;
+    openTime = std::chrono::steady_clock::now();
+    return true;
+}
+
+void TelemetryPublisher::Close()
+{
+    if (ring == nullptr)
+        return;
+
+    ring->closed.store(1, std::memory_order_release);
+    munmap(ring, mappedSize);
+    shm_unlink(name.c_str());
+    ring = nullptr;
+}
+
+void TelemetryPublisher::Publish(TelemetrySample &sample)
+{
+    if (ring == nullptr)
+        return;
+
+    sample.time = std::chrono::duration<double>(std::chrono::steady_clock::now() - openTime).count();
+
+    TelemetrySlot &slot = ring->slots[written % ring->capacity];
+    slot.sequence.store(2 * written + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(&slot.sample, &sample, sizeof(sample));
+    slot.sequence.store(2 * written + 2, std::memory_order_release);
+
+    written++;
+    ring->written.store(written, std::memory_order_release);
+}
+
+bool TelemetryReader::Attach(const char *name)
+{
+    Detach();
+
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0)
+        return false;
+
+    struct stat info;
+    void *mapped = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && size_t(info.st_size) >= offsetof(TelemetryRing, slots))
+        mapped = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED)
+        return false;
+
+    const TelemetryRing *candidate = static_cast<const TelemetryRing *>(mapped);
+    if (candidate->magic.load(std::memory_order_acquire) != cTelemetryMagic || candidate->version != cTelemetryVersion
+        || candidate->sampleSize != sizeof(TelemetrySample) || TelemetryRing::SizeFor(candidate->capacity) > size_t(info.st_size))
+    {
+        munmap(mapped, size_t(info.st_size));
+        return false;
+    }
+
+    ring = candidate;
+    mappedSize = size_t(info.st_size);
+    session = ring->session;
+
+    // Start with what's still in the ring
+    JPH::uint64 written = ring->written.load(std::memory_order_acquire);
+    cursor = written > ring->capacity ? written - ring->capacity : 0;
+    return true;
+}
+
+void TelemetryReader::Detach()
+{
+    if (ring == nullptr)
+        return;
+
+    munmap(const_cast<TelemetryRing *>(ring), mappedSize);
+    ring = nullptr;
+}
+
+#else
+
+bool TelemetryPublisher::Open(const char *name, JPH::uint32 capacity)
+{
+    JPH::Trace("Telemetry: shared memory export is only implemented for POSIX systems");
+    return false;
+}
+
+void TelemetryPublisher::Close()
+{
+}
+
+void TelemetryPublisher::Publish(TelemetrySample &sample)
+{
+}
+
+bool TelemetryReader::Attach(const char *name)
+{
+    return false;
+}
+
+void TelemetryReader::Detach()
+{
+}
+
+#endif // _WIN32
+
+bool TelemetryReader::IsStale() const
+{
+    return ring != nullptr && (ring->closed.load(std::memory_order_acquire) != 0 || ring->session != session);
+}
+
+JPH::uint64 TelemetryReader::ReadNew(std::vector<TelemetrySample> &out)
+{
+    if (ring == nullptr)
+        return 0;
+
+    JPH::uint64 lost = 0;
+    JPH::uint64 written = ring->written.load(std::memory_order_acquire);
+    if (written - cursor > ring->capacity)
+    {
+        lost += written - ring->capacity - cursor;
+        cursor = written - ring->capacity;
+    }
+
+    for (; cursor < written; cursor++)
+    {
+        const TelemetrySlot &slot = ring->slots[cursor % ring->capacity];
+
+        // Seqlock read: the copy only counts if the slot held this sample before and after copying it
+        JPH::uint64 before = slot.sequence.load(std::memory_order_acquire);
+        TelemetrySample sample;
+        memcpy(&sample, &slot.sample, sizeof(sample));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        JPH::uint64 after = slot.sequence.load(std::memory_order_relaxed);
+
+        if (before == 2 * cursor + 2 && after == before)
+            out.push_back(sample);
+        else
+            lost++;
+    }
+    return lost;
+}
+
+static double process_cpu_seconds()
+{
+#ifdef _WIN32
+    FILETIME creation, exit, kernel, user;
+    GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user);
+    auto to_seconds = [](const FILETIME &time) {
+        return double((JPH::uint64(time.dwHighDateTime) << 32) | time.dwLowDateTime) * 1.0e-7;
+    };
+    return to_seconds(kernel) + to_seconds(user);
+#else
+    timespec time;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time);
+    return double(time.tv_sec) + double(time.tv_nsec) * 1.0e-9;
+#endif
+}
+
+void StepMeter::Begin()
+{
+    wallStart = std::chrono::steady_clock::now();
+    cpuStart = process_cpu_seconds();
+}
+
+void StepMeter::End(int numThreads)
+{
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+    double cpu = process_cpu_seconds() - cpuStart;
+
+    lastMs = float(wall * 1000.0);
+    lastUtilization = wall > 0.0 && numThreads > 0 ? float(cpu / (wall * numThreads)) : 0.0f;
+    if (lastUtilization > 1.0f)
+        lastUtilization = 1.0f;
+}
@@ -0,0 +1,105 @@
+#ifndef TELEMETRY_HPP
+#define TELEMETRY_HPP
+
+#include <Jolt/Jolt.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+// One published record, usually one per simulation step
+struct TelemetrySample {
+  JPH::uint64 frame = 0;
+  double time = 0.0;           // seconds since the publisher was opened
+  float stepMs = 0.0f;         // wall time of PhysicsSystem::Update
+  float jobUtilization = 0.0f; // 0..1, see StepMeter
+  JPH::uint32 numThreads = 0;
+  JPH::uint32 numBodies = 0;
+  JPH::uint32 numActiveBodies = 0;
+  JPH::uint32 numContacts = 0;
+  JPH::uint64 heapLiveBytes = 0;
+  JPH::uint64 heapPeakBytes = 0;
+  JPH::uint64 numAllocations = 0;
+};
+
+struct TelemetryRing;
+
+// Publishes samples into a ring buffer in POSIX shared memory for an out-of-process viewer (see TelemetryViewer).
+//
+// Publishing copies the sample into the next slot between two stores of the slot's sequence number (a
+// seqlock), no system calls and no waiting, so it costs the same whether a viewer is attached or not.
+// Readers never write to the ring; they detect a slot that was overwritten while they copied it from its
+// sequence number and drop it. Only one publisher at a time can open a given name.
+class TelemetryPublisher {
+
+public:
+  TelemetryPublisher() = default;
+  ~TelemetryPublisher() { Close(); }
+
+  TelemetryPublisher(const TelemetryPublisher &) = delete;
+  TelemetryPublisher &operator=(const TelemetryPublisher &) = delete;
+
+  // name is a shared memory object name like "/jolt_telemetry". A stale ring of a crashed publisher is replaced,
+  // fails when the publisher of the existing ring is still running.
+  bool Open(const char *name, JPH::uint32 capacity = 1024);
+  void Close();
+  bool IsOpen() const { return ring != nullptr; }
+
+  // Fills in sample.time, does nothing when not open
+  void Publish(TelemetrySample &sample);
+
+private:
+  TelemetryRing *ring = nullptr;
+  size_t mappedSize = 0;
+  std::string name;
+  JPH::uint64 written = 0;
+  std::chrono::steady_clock::time_point openTime;
+};
+
+class TelemetryReader {
+
+public:
+  TelemetryReader() = default;
+  ~TelemetryReader() { Detach(); }
+
+  TelemetryReader(const TelemetryReader &) = delete;
+  TelemetryReader &operator=(const TelemetryReader &) = delete;
+
+  bool Attach(const char *name);
+  void Detach();
+  bool IsAttached() const { return ring != nullptr; }
+
+  // True once the publisher closed the ring (or a new publisher replaced it), Attach again to follow it
+  bool IsStale() const;
+
+  // Appends every sample published since the last call, oldest first. Returns the number of samples that
+  // were lost because the reader fell more than a ring behind or the publisher overwrote them while copying.
+  JPH::uint64 ReadNew(std::vector<TelemetrySample> &out);
+
+private:
+  const TelemetryRing *ring = nullptr;
+  size_t mappedSize = 0;
+  JPH::uint64 session = 0;
+  JPH::uint64 cursor = 0;
+};
+
+// Measures one PhysicsSystem::Update. Jolt's thread pool doesn't report how busy its threads are, so the
+// utilization is the CPU time the whole process used during the update divided by the wall time available
+// to the threads (wall time * threads). Other threads that run at the same time count as physics work.
+class StepMeter {
+
+public:
+  void Begin();
+  void End(int numThreads);
+
+  float LastMs() const { return lastMs; }
+  float LastUtilization() const { return lastUtilization; }
+
+private:
+  std::chrono::steady_clock::time_point wallStart;
+  double cpuStart = 0.0;
+  float lastMs = 0.0f;
+  float lastUtilization = 0.0f;
+};
+
+#endif // TELEMETRY_HPP
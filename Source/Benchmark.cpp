@@ -0,0 +1,482 @@
+// Jolt Physics Library (https://github.com/jrouwe/JoltPhysics)
+// SPDX-FileCopyrightText: 2021 Jorrit Rouwe
+// SPDX-License-Identifier: MIT
+
+// Benchmarks for the simulation helpers. Run without arguments to run all of them, or pass the names of the ones to run.
+
+#include <Jolt/Jolt.h>
+
+// Jolt includes
+#include <Jolt/RegisterTypes.h>
+#include <Jolt/ConfigurationString.h>
+#include <Jolt/Core/Factory.h>
+#include <Jolt/Core/TempAllocator.h>
+#include <Jolt/Core/JobSystemThreadPool.h>
+#include <Jolt/Physics/PhysicsSettings.h>
+#include <Jolt/Physics/PhysicsSystem.h>
+#include <Jolt/Physics/Collision/CastResult.h>
+#include <Jolt/Physics/Collision/Shape/BoxShape.h>
+#include <Jolt/Physics/Collision/Shape/SphereShape.h>
+#include <Jolt/Physics/Collision/Shape/MeshShape.h>
+#include <Jolt/Physics/Collision/Shape/HeightFieldShape.h>
+#include <Jolt/Core/HashCombine.h>
+#include <Jolt/Physics/Body/BodyCreationSettings.h>
+
+// STL includes
+#include <iostream>
+#include <iomanip>
+#include <cstdarg>
+#include <thread>
+#include <chrono>
+#include <random>
+#include <limits>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <functional>
+#include <filesystem>
+
+#include "Layers.h"
+#include "query_batch.hpp"
+#include "allocation_stats.hpp"
+#include "step_logic.hpp"
+#include "shape_cache.hpp"
+
+// Disable common warnings triggered by Jolt, you can use JPH_SUPPRESS_WARNING_PUSH / JPH_SUPPRESS_WARNING_POP to store and restore the warning state
+JPH_SUPPRESS_WARNINGS
+
+using namespace JPH;
+using namespace JPH::literals;
+using namespace std;
+
+// Callback for traces
+static void TraceImpl(const char *inFMT, ...)
+{
+	va_list list;
+	va_start(list, inFMT);
+	char buffer[1024];
+	vsnprintf(buffer, sizeof(buffer), inFMT, list);
+	va_end(list);
+
+	cout << buffer << endl;
+}
+
+#ifdef JPH_ENABLE_ASSERTS
+
+// Callback for asserts
+static bool AssertFailedImpl(const char *inExpression, const char *inMessage, const char *inFile, uint inLine)
+{
+	cout << inFile << ":" << inLine << ": (" << inExpression << ") " << (inMessage != nullptr? inMessage : "") << endl;
+	return true;
+};
+
+#endif // JPH_ENABLE_ASSERTS
+
+// Returns the time it takes to run inFunction in milliseconds, best of inRepeat runs
+static double sTimeBestOf(int inRepeat, const function<void()> &inFunction)
+{
+	double best = numeric_limits<double>::max();
+	for (int i = 0; i < inRepeat; ++i)
+	{
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		inFunction();
+		best = min(best, chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+	}
+	return best;
+}
+
+// Everything a benchmark needs to create and step a world
+struct BenchmarkContext
+{
+	BPLayerInterfaceImpl				mBroadPhaseLayerInterface;
+	ObjectVsBroadPhaseLayerFilterImpl	mObjectVsBroadPhaseLayerFilter;
+	ObjectLayerPairFilterImpl			mObjectVsObjectLayerFilter;
+	TempAllocatorImpl					mTempAllocator { 32 * 1024 * 1024 };
+	JobSystemThreadPool					mJobSystem { cMaxPhysicsJobs, cMaxPhysicsBarriers, int(thread::hardware_concurrency()) - 1 };
+
+	void								InitPhysicsSystem(PhysicsSystem &ioSystem, uint inMaxBodies, uint inMaxBodyPairs = 65536, uint inMaxContactConstraints = 65536)
+	{
+		ioSystem.Init(inMaxBodies, 0, inMaxBodyPairs, inMaxContactConstraints, mBroadPhaseLayerInterface, mObjectVsBroadPhaseLayerFilter, mObjectVsObjectLayerFilter);
+	}
+};
+
+// A large static scene: a floor with a grid of boxes of random height on top, like a city block
+static void sCreateStaticScene(PhysicsSystem &ioSystem, int inGridSize, float inSpacing)
+{
+	BodyInterface &body_interface = ioSystem.GetBodyInterfaceNoLock();
+	default_random_engine random(1234);
+	uniform_real_distribution<float> height(0.5f, 10.0f);
+
+	float half_extent = 0.5f * inGridSize * inSpacing;
+	BodyIDVector bodies;
+	bodies.push_back(body_interface.CreateBody(BodyCreationSettings(new BoxShape(Vec3(half_extent, 1.0f, half_extent)), RVec3(0.0_r, -1.0_r, 0.0_r), Quat::sIdentity(), EMotionType::Static, Layers::NON_MOVING))->GetID());
+
+	for (int x = 0; x < inGridSize; ++x)
+		for (int z = 0; z < inGridSize; ++z)
+		{
+			float h = height(random);
+			RVec3 position(Real(-half_extent + (x + 0.5f) * inSpacing), Real(h), Real(-half_extent + (z + 0.5f) * inSpacing));
+			Body *box = body_interface.CreateBody(BodyCreationSettings(new BoxShape(Vec3(0.3f * inSpacing, h, 0.3f * inSpacing)), position, Quat::sIdentity(), EMotionType::Static, Layers::NON_MOVING));
+			bodies.push_back(box->GetID());
+		}
+
+	// Adding everything in one go keeps the broad phase tree efficient
+	BodyInterface::AddState state = body_interface.AddBodiesPrepare(bodies.data(), int(bodies.size()));
+	body_interface.AddBodiesFinalize(bodies.data(), int(bodies.size()), state, EActivation::DontActivate);
+	ioSystem.OptimizeBroadPhase();
+}
+
+// Rays per second of QueryBatch compared to casting the same rays one by one on the calling thread
+static void sBenchmarkRays(BenchmarkContext &ioContext)
+{
+	const int cGridSize = 100;
+	const float cSpacing = 4.0f;
+	const int cNumSensors = 64;
+	const int cRaysPerSensor = 4096;
+	const float cRange = 150.0f;
+
+	PhysicsSystem system;
+	ioContext.InitPhysicsSystem(system, 2 * cGridSize * cGridSize);
+	sCreateStaticScene(system, cGridSize, cSpacing);
+
+	// Lidar like sensors: every sensor sweeps a sphere of rays around itself
+	default_random_engine random(5678);
+	uniform_real_distribution<float> position(-0.5f * cGridSize * cSpacing, 0.5f * cGridSize * cSpacing);
+	vector<RRayCast> rays;
+	rays.reserve(cNumSensors * cRaysPerSensor);
+	for (int s = 0; s < cNumSensors; ++s)
+	{
+		RVec3 origin(Real(position(random)), 2.0_r, Real(position(random)));
+		for (int r = 0; r < cRaysPerSensor; ++r)
+		{
+			// Fibonacci sphere for an even spread of directions
+			float y = 1.0f - 2.0f * (r + 0.5f) / cRaysPerSensor;
+			float radius = sqrt(1.0f - y * y);
+			float phi = r * 2.399963f;
+			rays.push_back(RRayCast(origin, cRange * Vec3(radius * cos(phi), y, radius * sin(phi))));
+		}
+	}
+
+	const NarrowPhaseQuery &query = system.GetNarrowPhaseQueryNoLock();
+
+	int serial_hits = 0;
+	double serial_ms = sTimeBestOf(3, [&]() {
+		serial_hits = 0;
+		for (const RRayCast &ray : rays)
+		{
+			RayCastResult hit;
+			if (query.CastRay(ray, hit))
+				++serial_hits;
+		}
+	});
+
+	QueryBatch batch(ioContext.mJobSystem);
+	RayBatchResults results;
+	results.Resize(rays.size());
+	double batch_ms = sTimeBestOf(5, [&]() { batch.CastRays(query, rays.data(), rays.size(), results); });
+
+	int batch_hits = 0;
+	for (const BodyID &id : results.bodyID)
+		if (!id.IsInvalid())
+			++batch_hits;
+
+	cout << "rays: " << system.GetNumBodies() << " static bodies, " << rays.size() << " rays, " << ioContext.mJobSystem.GetMaxConcurrency() << " threads" << endl;
+	cout << fixed << setprecision(0);
+	cout << "  serial:  " << setw(12) << rays.size() / (serial_ms * 1.0e-3) << " rays/s (" << serial_hits << " hits)" << endl;
+	cout << "  batched: " << setw(12) << rays.size() / (batch_ms * 1.0e-3) << " rays/s (" << batch_hits << " hits)" << endl;
+	cout << defaultfloat;
+}
+
+// Step time and heap usage of a pile of boxes, at the world origin and far away from it.
+// Build once with DOUBLE_PRECISION=OFF and once with ON and compare (see Build/benchmark_precision.sh).
+static void sBenchmarkStep(BenchmarkContext &ioContext)
+{
+	const int cGridSize = 32;
+	const int cLayers = 4;
+	const int cNumSteps = 300;
+	const float cDeltaTime = 1.0f / 60.0f;
+
+#ifdef JPH_DOUBLE_PRECISION
+	const char *precision = "double";
+#else
+	const char *precision = "float";
+#endif
+	cout << "step: " << precision << " precision, sizeof(Body) = " << sizeof(Body) << ", " << cGridSize * cGridSize * cLayers << " boxes, " << cNumSteps << " steps" << endl;
+
+	for (Real offset : { 0.0_r, 10000.0_r })
+	{
+		size_t bytes_before = GetAllocationStats().liveBytes;
+
+		PhysicsSystem *system = new PhysicsSystem;
+		ioContext.InitPhysicsSystem(*system, 2 * cGridSize * cGridSize * cLayers);
+		BodyInterface &body_interface = system->GetBodyInterfaceNoLock();
+		RVec3 origin(offset, 0.0_r, offset);
+
+		BodyIDVector bodies;
+		bodies.push_back(body_interface.CreateBody(BodyCreationSettings(new BoxShape(Vec3(100.0f, 1.0f, 100.0f)), origin - RVec3(0.0_r, 1.0_r, 0.0_r), Quat::sIdentity(), EMotionType::Static, Layers::NON_MOVING))->GetID());
+		RefConst<Shape> box_shape = new BoxShape(Vec3::sReplicate(0.5f));
+		for (int y = 0; y < cLayers; ++y)
+			for (int x = 0; x < cGridSize; ++x)
+				for (int z = 0; z < cGridSize; ++z)
+				{
+					RVec3 position = origin + Vec3(1.5f * (x - 0.5f * cGridSize), 0.5f + 1.2f * y, 1.5f * (z - 0.5f * cGridSize));
+					bodies.push_back(body_interface.CreateBody(BodyCreationSettings(box_shape, position, Quat::sIdentity(), EMotionType::Dynamic, Layers::MOVING))->GetID());
+				}
+		BodyInterface::AddState state = body_interface.AddBodiesPrepare(bodies.data(), int(bodies.size()));
+		body_interface.AddBodiesFinalize(bodies.data(), int(bodies.size()), state, EActivation::Activate);
+		system->OptimizeBroadPhase();
+
+		size_t world_bytes = GetAllocationStats().liveBytes - bytes_before;
+		ResetPeakAllocation();
+
+		double total_ms = 0.0, worst_ms = 0.0;
+		for (int step = 0; step < cNumSteps; ++step)
+		{
+			chrono::steady_clock::time_point start = chrono::steady_clock::now();
+			system->Update(cDeltaTime, 1, &ioContext.mTempAllocator, &ioContext.mJobSystem);
+			double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+			total_ms += ms;
+			worst_ms = max(worst_ms, ms);
+		}
+
+		size_t peak_bytes = GetAllocationStats().peakBytes - bytes_before;
+
+		cout << fixed << setprecision(3);
+		cout << "  offset " << setw(8) << double(offset) << " m: avg " << total_ms / cNumSteps << " ms, worst " << worst_ms << " ms, world " << world_bytes / 1024 << " KiB, peak " << peak_bytes / 1024 << " KiB" << endl;
+		cout << defaultfloat;
+
+		delete system;
+	}
+}
+
+// Keeps every body hovering at its own target height with a damped spring force, like a crowd of drones
+class HoverControllers final : public BodyLogic
+{
+public:
+	// Serial version, runs on the calling thread between updates
+	void								UpdateAll(BodyInterface &inBodyInterface)
+	{
+		for (size_t i = 0; i < mBodies.size(); ++i)
+			UpdateBody(inBodyInterface, i);
+	}
+
+	// See: BodyLogic
+	virtual size_t						GetNumBodies() const override
+	{
+		return mBodies.size();
+	}
+
+	virtual void						UpdateBodies(const PhysicsStepListenerContext &inContext, BodyInterface &inBodyInterface, size_t inBegin, size_t inEnd) override
+	{
+		for (size_t i = inBegin; i < inEnd; ++i)
+			UpdateBody(inBodyInterface, i);
+	}
+
+	BodyIDVector						mBodies;			// Sorted by index
+	vector<float>						mTargetHeight;		// Per body, same order as mBodies
+	vector<float>						mMass;
+
+private:
+	void								UpdateBody(BodyInterface &inBodyInterface, size_t inIndex)
+	{
+		BodyID id = mBodies[inIndex];
+		RVec3 position = inBodyInterface.GetCenterOfMassPosition(id);
+		Vec3 velocity = inBodyInterface.GetLinearVelocity(id);
+
+		// Spring towards the target height, damping on all axes and cancel gravity
+		float error = mTargetHeight[inIndex] - float(position.GetY());
+		Vec3 force = mMass[inIndex] * (Vec3(0, 40.0f * error + 9.81f, 0) - 6.0f * velocity);
+		inBodyInterface.AddForce(id, force);
+	}
+};
+
+// Thousands of force applying controllers, run serially in the main loop before every update compared to running them
+// inside the update as step listener jobs through StepLogicScheduler
+static void sBenchmarkControllers(BenchmarkContext &ioContext)
+{
+	const int cGridSize = 64;
+	const int cNumSteps = 300;
+	const float cDeltaTime = 1.0f / 60.0f;
+
+	cout << "controllers: " << cGridSize * cGridSize << " hovering spheres, " << cNumSteps << " steps, " << ioContext.mJobSystem.GetMaxConcurrency() << " threads" << endl;
+
+	for (bool parallel : { false, true })
+	{
+		PhysicsSystem system;
+		ioContext.InitPhysicsSystem(system, cGridSize * cGridSize);
+		BodyInterface &body_interface = system.GetBodyInterfaceNoLock();
+
+		default_random_engine random(4321);
+		uniform_real_distribution<float> height(2.0f, 20.0f);
+
+		HoverControllers controllers;
+		RefConst<Shape> sphere_shape = new SphereShape(0.4f);
+		for (int x = 0; x < cGridSize; ++x)
+			for (int z = 0; z < cGridSize; ++z)
+			{
+				// Controlled bodies keep moving a little, don't let them fall asleep or the step listeners are skipped
+				BodyCreationSettings settings(sphere_shape, RVec3(Real(x - 0.5f * cGridSize), 1.0_r, Real(z - 0.5f * cGridSize)), Quat::sIdentity(), EMotionType::Dynamic, Layers::MOVING);
+				settings.mAllowSleeping = false;
+				Body *body = body_interface.CreateBody(settings);
+				controllers.mBodies.push_back(body->GetID());
+				controllers.mTargetHeight.push_back(height(random));
+				controllers.mMass.push_back(1.0f / body->GetMotionProperties()->GetInverseMass());
+			}
+		BodyInterface::AddState state = body_interface.AddBodiesPrepare(controllers.mBodies.data(), int(controllers.mBodies.size()));
+		body_interface.AddBodiesFinalize(controllers.mBodies.data(), int(controllers.mBodies.size()), state, EActivation::Activate);
+		system.OptimizeBroadPhase();
+
+		StepLogicScheduler scheduler(system, ioContext.mJobSystem.GetMaxConcurrency());
+		if (parallel)
+			scheduler.AddBodyLogic(controllers);
+
+		double total_ms = 0.0, logic_ms = 0.0;
+		for (int step = 0; step < cNumSteps; ++step)
+		{
+			chrono::steady_clock::time_point start = chrono::steady_clock::now();
+			if (!parallel)
+			{
+				// This is what game logic in the main loop would do, with the locking body interface
+				controllers.UpdateAll(system.GetBodyInterface());
+				logic_ms += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+			}
+			system.Update(cDeltaTime, 1, &ioContext.mTempAllocator, &ioContext.mJobSystem);
+			total_ms += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+		}
+
+		// Check the controllers did their job in both versions
+		float max_error = 0.0f;
+		for (size_t i = 0; i < controllers.mBodies.size(); ++i)
+			max_error = max(max_error, abs(controllers.mTargetHeight[i] - float(body_interface.GetCenterOfMassPosition(controllers.mBodies[i]).GetY())));
+
+		cout << fixed << setprecision(3);
+		if (parallel)
+			cout << "  step listeners (" << scheduler.NumChunks() << " chunks): " << total_ms / cNumSteps << " ms per frame";
+		else
+			cout << "  serial main loop:   " << total_ms / cNumSteps << " ms per frame (logic " << logic_ms / cNumSteps << " ms)";
+		cout << ", max height error " << max_error << " m" << endl;
+		cout << defaultfloat;
+	}
+}
+
+// Cooking a terrain height field and mesh compared to loading them from a ShapeCache
+static void sBenchmarkShapeCache(BenchmarkContext &ioContext)
+{
+	const uint cHeightFieldSize = 1024;
+	const int cMeshSize = 256;
+	const float cCellSize = 2.0f;
+
+	// Rolling hills
+	vector<float> heights(cHeightFieldSize * cHeightFieldSize);
+	for (uint y = 0; y < cHeightFieldSize; ++y)
+		for (uint x = 0; x < cHeightFieldSize; ++x)
+			heights[y * cHeightFieldSize + x] = 5.0f * sin(0.05f * x) * cos(0.07f * y) + 2.0f * sin(0.3f * x + 0.2f * y);
+	HeightFieldShapeSettings height_field_settings(heights.data(), Vec3(-0.5f * cHeightFieldSize * cCellSize, 0, -0.5f * cHeightFieldSize * cCellSize), Vec3(cCellSize, 1, cCellSize), cHeightFieldSize);
+	height_field_settings.SetEmbedded();
+	uint64 height_field_hash = HashBytes(heights.data(), uint(heights.size() * sizeof(float)));
+
+	VertexList vertices;
+	IndexedTriangleList triangles;
+	for (int z = 0; z <= cMeshSize; ++z)
+		for (int x = 0; x <= cMeshSize; ++x)
+			vertices.push_back(Float3(cCellSize * (x - 0.5f * cMeshSize), 3.0f * sin(0.1f * x) * sin(0.13f * z), cCellSize * (z - 0.5f * cMeshSize)));
+	for (int z = 0; z < cMeshSize; ++z)
+		for (int x = 0; x < cMeshSize; ++x)
+		{
+			uint32 v = uint32(z * (cMeshSize + 1) + x);
+			triangles.push_back(IndexedTriangle(v, v + cMeshSize + 1, v + 1));
+			triangles.push_back(IndexedTriangle(v + 1, v + cMeshSize + 1, v + cMeshSize + 2));
+		}
+	MeshShapeSettings mesh_settings(vertices, triangles);
+	mesh_settings.SetEmbedded();
+	uint64 mesh_hash = HashBytes(triangles.data(), uint(triangles.size() * sizeof(IndexedTriangle)), HashBytes(vertices.data(), uint(vertices.size() * sizeof(Float3))));
+
+	// Start from an empty cache so the first pass cooks
+	string directory = (filesystem::temp_directory_path() / "jolt_shape_cache_benchmark").string();
+	error_code error;
+	filesystem::remove_all(directory, error);
+
+	cout << "shapecache: " << cHeightFieldSize << "x" << cHeightFieldSize << " height field, " << triangles.size() << " triangle mesh, cache in " << directory << endl;
+
+	ShapeRefC cooked[2];
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		// A new cache every pass like a new process would, the settings still hold the cooked shape so start over from the file
+		ShapeCache cache(directory);
+		height_field_settings.ClearCachedResult();
+		mesh_settings.ClearCachedResult();
+
+		ShapeRefC height_field = cache.GetOrCook("terrain_height_field", height_field_hash, height_field_settings);
+		ShapeRefC mesh = cache.GetOrCook("terrain_mesh", mesh_hash, mesh_settings);
+		if (height_field == nullptr || mesh == nullptr)
+			return;
+
+		const ShapeCacheStats &stats = cache.GetStats();
+		cout << fixed << setprecision(1);
+		if (pass == 0)
+			cout << "  cook: " << setw(8) << stats.cookMs << " ms (+" << stats.saveMs << " ms saving)";
+		else
+			cout << "  load: " << setw(8) << stats.loadMs << " ms (" << stats.hits << " of 2 from the cache)";
+		cout << ", " << (height_field->GetStats().mSizeBytes + mesh->GetStats().mSizeBytes) / 1024 << " KiB of shapes" << endl;
+		cout << defaultfloat;
+
+		if (pass == 0)
+		{
+			cooked[0] = height_field;
+			cooked[1] = mesh;
+		}
+		else if (cooked[0]->GetStats().mSizeBytes != height_field->GetStats().mSizeBytes || cooked[1]->GetStats().mSizeBytes != mesh->GetStats().mSizeBytes)
+			cout << "  loaded shapes differ from the cooked ones!" << endl;
+	}
+
+	filesystem::remove_all(directory, error);
+}
+
+struct BenchmarkEntry
+{
+	const char *						mName;
+	void								(*mFunction)(BenchmarkContext &);
+};
+
+static const BenchmarkEntry sBenchmarks[] =
+{
+	{ "rays",		sBenchmarkRays },
+	{ "step",		sBenchmarkStep },
+	{ "controllers",	sBenchmarkControllers },
+	{ "shapecache",	sBenchmarkShapeCache },
+};
+
+int main(int argc, char** argv)
+{
+	// Same as the default allocator, but lets the benchmarks report heap usage
+	RegisterCountingAllocator();
+
+	Trace = TraceImpl;
+	JPH_IF_ENABLE_ASSERTS(AssertFailed = AssertFailedImpl;)
+
+	Factory::sInstance = new Factory();
+	RegisterTypes();
+
+	// Which instruction sets this build uses, results of different ISA_LEVEL builds are only comparable with this
+	cout << "Jolt: " << GetConfigurationString() << endl;
+
+	{
+		BenchmarkContext context;
+
+		for (const BenchmarkEntry &benchmark : sBenchmarks)
+		{
+			bool run = argc < 2;
+			for (int i = 1; i < argc; ++i)
+				run |= string(argv[i]) == benchmark.mName;
+			if (run)
+				benchmark.mFunction(context);
+		}
+	}
+
+	UnregisterTypes();
+
+	delete Factory::sInstance;
+	Factory::sInstance = nullptr;
+
+	return 0;
+}
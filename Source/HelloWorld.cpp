@@ -25,9 +25,16 @@
 #include <cstdarg>
 #include <thread>
 #include <chrono>
+#include <cstdlib>
+#include <string>
 
 #include <glm/gtc/type_ptr.hpp>
 #include "physics_debug_renderer.hpp"
+#include "body_instance_cache.hpp"
+#include "capacity_monitor.hpp"
+#include "allocation_stats.hpp"
+#include "telemetry.hpp"
+#include "Layers.h"
 
 #include <GLFW/glfw3.h>
 
@@ -72,106 +79,6 @@ static bool AssertFailedImpl(const char *inExpression, const char *inMessage, co
 
 #endif // JPH_ENABLE_ASSERTS
 
-// Layer that objects can be in, determines which other objects it can collide with
-// Typically you at least want to have 1 layer for moving bodies and 1 layer for static bodies, but you can have more
-// layers if you want. E.g. you could have a layer for high detail collision (which is not used by the physics simulation
-// but only if you do collision testing).
-namespace Layers
-{
-	static constexpr ObjectLayer NON_MOVING = 0;
-	static constexpr ObjectLayer MOVING = 1;
-	static constexpr ObjectLayer NUM_LAYERS = 2;
-};
-
-/// Class that determines if two object layers can collide
-class ObjectLayerPairFilterImpl : public ObjectLayerPairFilter
-{
-public:
-	virtual bool					ShouldCollide(ObjectLayer inObject1, ObjectLayer inObject2) const override
-	{
-		switch (inObject1)
-		{
-		case Layers::NON_MOVING:
-			return inObject2 == Layers::MOVING; // Non moving only collides with moving
-		case Layers::MOVING:
-			return true; // Moving collides with everything
-		default:
-			JPH_ASSERT(false);
-			return false;
-		}
-	}
-};
-
-// Each broadphase layer results in a separate bounding volume tree in the broad phase. You at least want to have
-// a layer for non-moving and moving objects to avoid having to update a tree full of static objects every frame.
-// You can have a 1-on-1 mapping between object layers and broadphase layers (like in this case) but if you have
-// many object layers you'll be creating many broad phase trees, which is not efficient. If you want to fine tune
-// your broadphase layers define JPH_TRACK_BROADPHASE_STATS and look at the stats reported on the TTY.
-namespace BroadPhaseLayers
-{
-	static constexpr BroadPhaseLayer NON_MOVING(0);
-	static constexpr BroadPhaseLayer MOVING(1);
-	static constexpr uint NUM_LAYERS(2);
-};
-
-// BroadPhaseLayerInterface implementation
-// This defines a mapping between object and broadphase layers.
-class BPLayerInterfaceImpl final : public BroadPhaseLayerInterface
-{
-public:
-									BPLayerInterfaceImpl()
-	{
-		// Create a mapping table from object to broad phase layer
-		mObjectToBroadPhase[Layers::NON_MOVING] = BroadPhaseLayers::NON_MOVING;
-		mObjectToBroadPhase[Layers::MOVING] = BroadPhaseLayers::MOVING;
-	}
-
-	virtual uint					GetNumBroadPhaseLayers() const override
-	{
-		return BroadPhaseLayers::NUM_LAYERS;
-	}
-
-	virtual BroadPhaseLayer			GetBroadPhaseLayer(ObjectLayer inLayer) const override
-	{
-		JPH_ASSERT(inLayer < Layers::NUM_LAYERS);
-		return mObjectToBroadPhase[inLayer];
-	}
-
-#if defined(JPH_EXTERNAL_PROFILE) || defined(JPH_PROFILE_ENABLED)
-	virtual const char *			GetBroadPhaseLayerName(BroadPhaseLayer inLayer) const override
-	{
-		switch ((BroadPhaseLayer::Type)inLayer)
-		{
-		case (BroadPhaseLayer::Type)BroadPhaseLayers::NON_MOVING:	return "NON_MOVING";
-		case (BroadPhaseLayer::Type)BroadPhaseLayers::MOVING:		return "MOVING";
-		default:													JPH_ASSERT(false); return "INVALID";
-		}
-	}
-#endif // JPH_EXTERNAL_PROFILE || JPH_PROFILE_ENABLED
-
-private:
-	BroadPhaseLayer					mObjectToBroadPhase[Layers::NUM_LAYERS];
-};
-
-/// Class that determines if an object layer can collide with a broadphase layer
-class ObjectVsBroadPhaseLayerFilterImpl : public ObjectVsBroadPhaseLayerFilter
-{
-public:
-	virtual bool				ShouldCollide(ObjectLayer inLayer1, BroadPhaseLayer inLayer2) const override
-	{
-		switch (inLayer1)
-		{
-		case Layers::NON_MOVING:
-			return inLayer2 == BroadPhaseLayers::MOVING;
-		case Layers::MOVING:
-			return true;
-		default:
-			JPH_ASSERT(false);
-			return false;
-		}
-	}
-};
-
 // An example contact listener
 class MyContactListener : public ContactListener
 {
@@ -217,12 +124,83 @@ public:
 };
 
 
+static void PrintUsage()
+{
+	cout << "Usage: HelloWorld [options]" << endl
+		 << "  --offscreen              render into an offscreen framebuffer of a hidden window" << endl
+		 << "  --surfaceless            render into an offscreen framebuffer without any window system (EGL)" << endl
+		 << "  --capture <target>       stream frames to 'frame_%05d.ppm', a single file or '|command'" << endl
+		 << "  --raw                    capture raw RGB24 instead of PPM" << endl
+		 << "  --steps <n>              stop after n steps (0 = until the window is closed)" << endl
+		 << "  --world-offset <m>       move the scene and the camera m meters away from the origin (try with DOUBLE_PRECISION)" << endl
+		 << "  --immediate              draw through PhysicsSystem::DrawBodies instead of the body instance cache" << endl
+		 << "  --parallel-draw          record the draw commands of the bodies on the job system" << endl
+		 << "  --labels                 draw the ID and speed of every body next to it" << endl
+		 << "  --profile                show min/avg/p99 of the CPU and GPU frame times" << endl
+		 << "  --profile-csv <path>     write the frame times of every frame to a CSV file" << endl
+		 << "  --capacity-file <path>   start with the capacities recommended by the last run and store the new recommendation" << endl
+		 << "  --telemetry [name]       publish step stats to shared memory for TelemetryViewer (default /jolt_telemetry)" << endl;
+}
+
 // Program entry point
 int main(int argc, char** argv)
 {
+	// Parse the command line
+	RenderTarget render_target = RenderTarget::Window;
+	const char *capture_target = nullptr;
+	CaptureFormat capture_format = CaptureFormat::PPM;
+	uint max_steps = 0;
+	bool draw_immediate = false;
+	bool draw_parallel = false;
+	bool draw_labels = false;
+	bool show_profile = false;
+	const char *profile_csv = nullptr;
+	Real world_offset = 0.0_r;
+	const char *capacity_file = nullptr;
+	const char *telemetry_name = nullptr;
+	for (int i = 1; i < argc; ++i)
+	{
+		string arg = argv[i];
+		if (arg == "--offscreen")
+			render_target = RenderTarget::HiddenWindow;
+		else if (arg == "--surfaceless")
+			render_target = RenderTarget::Surfaceless;
+		else if (arg == "--capture" && i + 1 < argc)
+			capture_target = argv[++i];
+		else if (arg == "--raw")
+			capture_format = CaptureFormat::Raw;
+		else if (arg == "--steps" && i + 1 < argc)
+			max_steps = uint(atoi(argv[++i]));
+		else if (arg == "--world-offset" && i + 1 < argc)
+			world_offset = Real(atof(argv[++i]));
+		else if (arg == "--immediate")
+			draw_immediate = true;
+		else if (arg == "--parallel-draw")
+			draw_parallel = true;
+		else if (arg == "--labels")
+			draw_labels = true;
+		else if (arg == "--profile")
+			show_profile = true;
+		else if (arg == "--profile-csv" && i + 1 < argc)
+			profile_csv = argv[++i];
+		else if (arg == "--capacity-file" && i + 1 < argc)
+			capacity_file = argv[++i];
+		else if (arg == "--telemetry")
+			telemetry_name = i + 1 < argc && argv[i + 1][0] == '/'? argv[++i] : "/jolt_telemetry";
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
 	// Register allocation hook. In this example we'll just let Jolt use malloc / free but you can override these if you want (see Memory.h).
 	// This needs to be done before any other Jolt function is called.
-	RegisterDefaultAllocator();
+	// Telemetry reports the heap usage of Jolt, which needs the counting allocator.
+	if (telemetry_name != nullptr)
+		RegisterCountingAllocator();
+	else
+		RegisterDefaultAllocator();
 
 	// Install trace and assert callbacks
 	Trace = TraceImpl;
@@ -238,7 +216,13 @@ int main(int argc, char** argv)
 	RegisterTypes();
 
 	// Init debug renderer
-	PhysicsDebugRenderer* mDebugRenderer = new PhysicsDebugRenderer();
+	PhysicsDebugRenderer* mDebugRenderer = new PhysicsDebugRenderer(render_target);
+	if (capture_target != nullptr && !mDebugRenderer->StartCapture(capture_target, capture_format))
+		return 1;
+
+	// Where the scene is placed, far away from the origin this needs DOUBLE_PRECISION to simulate accurately
+	RVec3 scene_origin(world_offset, 0.0_r, world_offset);
+	mDebugRenderer->SetCameraPosition(scene_origin + Vec3(0.0f, 1.0f, 10.0f));
 
 	// We need a temp allocator for temporary allocations during the physics update. We're
 	// pre-allocating 10 MB to avoid having to do allocations during the physics update.#include <glm/gtc/type_ptr.hpp>
@@ -270,6 +254,11 @@ int main(int argc, char** argv)
 	// Note: This value is low because this is a simple test. For a real project use something in the order of 10240.
 	const uint cMaxContactConstraints = 1024;
 
+	// The values above are the minimum, a previous run may have recommended larger buffers
+	PhysicsCapacity capacity { cMaxBodies, cMaxBodyPairs, cMaxContactConstraints };
+	if (capacity_file != nullptr && CapacityMonitor::Load(capacity_file, capacity))
+		cout << "Capacities from " << capacity_file << ": " << capacity.maxBodies << " bodies, " << capacity.maxBodyPairs << " body pairs, " << capacity.maxContactConstraints << " contact constraints" << endl;
+
 	// Create mapping table from object layer to broadphase layer
 	// Note: As this is an interface, PhysicsSystem will take a reference to this so this instance needs to stay alive!
 	// Also have a look at BroadPhaseLayerInterfaceTable or BroadPhaseLayerInterfaceMask for a simpler interface.
@@ -287,19 +276,29 @@ int main(int argc, char** argv)
 
 	// Now we can create the actual physics system.
 	PhysicsSystem physics_system;
-	physics_system.Init(cMaxBodies, cNumBodyMutexes, cMaxBodyPairs, cMaxContactConstraints, broad_phase_layer_interface, object_vs_broadphase_layer_filter, object_vs_object_layer_filter);
+	physics_system.Init(capacity.maxBodies, cNumBodyMutexes, capacity.maxBodyPairs, capacity.maxContactConstraints, broad_phase_layer_interface, object_vs_broadphase_layer_filter, object_vs_object_layer_filter);
 
 	// A body activation listener gets notified when bodies activate and go to sleep
 	// Note that this is called from a job so whatever you do here needs to be thread safe.
 	// Registering one is entirely optional.
 	MyBodyActivationListener body_activation_listener;
-	physics_system.SetBodyActivationListener(&body_activation_listener);
+
+	// The renderer keeps a GPU instance slot per body and only rewrites the slots of active bodies, it learns which bodies are
+	// active through activation events so it sits in front of our own listener. Created and destroyed bodies are reported
+	// with BodyAdded / BodyRemoved.
+	BodyInstanceCache body_instances(*mDebugRenderer);
+	body_instances.SetForwardListener(&body_activation_listener);
+	physics_system.SetBodyActivationListener(&body_instances);
 
 	// A contact listener gets notified when bodies (are about to) collide, and when they separate again.
 	// Note that this is called from a job so whatever you do here needs to be thread safe.
 	// Registering one is entirely optional.
 	MyContactListener contact_listener;
-	physics_system.SetContactListener(&contact_listener);
+
+	// The capacity monitor counts contacts to track how full the buffers passed to Init get, it passes everything on to our own listener
+	CapacityMonitor capacity_monitor(capacity);
+	capacity_monitor.SetForwardListener(&contact_listener);
+	physics_system.SetContactListener(&capacity_monitor);
 
 	// The main way to interact with the bodies in the physics system is through the body interface. There is a locking and a non-locking
 	// variant of this. We're going to use the locking version (even though we're not planning to access bodies from multiple threads)
@@ -316,18 +315,20 @@ int main(int argc, char** argv)
 	ShapeRefC floor_shape = floor_shape_result.Get(); // We don't expect an error here, but you can check floor_shape_result for HasError() / GetError()
 
 	// Create the settings for the body itself. Note that here you can also set other properties like the restitution / friction.
-	BodyCreationSettings floor_settings(floor_shape, RVec3(0.0_r, -1.0_r, 0.0_r), Quat::sIdentity(), EMotionType::Static, Layers::NON_MOVING);
+	BodyCreationSettings floor_settings(floor_shape, scene_origin + RVec3(0.0_r, -1.0_r, 0.0_r), Quat::sIdentity(), EMotionType::Static, Layers::NON_MOVING);
 
 	// Create the actual rigid body
 	Body *floor = body_interface.CreateBody(floor_settings); // Note that if we run out of bodies this can return nullptr
+	body_instances.BodyAdded(floor->GetID());
 
 	// Add it to the world
 	body_interface.AddBody(floor->GetID(), EActivation::DontActivate);
 
 	// Now create a dynamic body to bounce on the floor
 	// Note that this uses the shorthand version of creating and adding a body to the world
-	BodyCreationSettings sphere_settings(new SphereShape(0.5f), RVec3(0.0_r, 2.0_r, 0.0_r), Quat::sIdentity(), EMotionType::Dynamic, Layers::MOVING);
+	BodyCreationSettings sphere_settings(new SphereShape(0.5f), scene_origin + RVec3(0.0_r, 2.0_r, 0.0_r), Quat::sIdentity(), EMotionType::Dynamic, Layers::MOVING);
 	BodyID sphere_id = body_interface.CreateAndAddBody(sphere_settings, EActivation::Activate);
+	body_instances.BodyAdded(sphere_id);
 	// Now you can interact with the dynamic body, in this case we're going to give it a velocity.
 	// (note that if we had used CreateBody then we could have set the velocity straight on the body before adding it to the physics system)
 	body_interface.SetLinearVelocity(sphere_id, Vec3(0.0f, -5.0f, 0.0f));
@@ -342,7 +343,15 @@ int main(int argc, char** argv)
 
 	// Now we're ready to simulate the body, keep simulating until it goes to sleep
 	uint step = 0;
-	while (!glfwWindowShouldClose(mDebugRenderer->window))
+	mDebugRenderer->SetProfilerOverlay(show_profile);
+	if (profile_csv != nullptr && !mDebugRenderer->GetProfiler().StartCsv(profile_csv))
+		cerr << "Error: could not write " << profile_csv << endl;
+	TelemetryPublisher telemetry;
+	if (telemetry_name != nullptr && !telemetry.Open(telemetry_name))
+		cerr << "Error: could not publish telemetry to " << telemetry_name << endl;
+	StepMeter step_meter;
+	std::chrono::steady_clock::time_point next_frame = std::chrono::steady_clock::now();
+	while (!mDebugRenderer->ShouldClose() && (max_steps == 0 || step < max_steps))
 	{
 		// Next step
 		++step;
@@ -356,37 +365,93 @@ int main(int argc, char** argv)
 
         // Render
         // -----
-		// glClearColor(0.05f, 0.05f, 0.05f, 1.0f);
-        glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-  		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		mDebugRenderer->BeginFrame();
 
+		if (draw_immediate)
+		{
+			BodyManager::DrawSettings settings;
+			physics_system.DrawBodies(settings, mDebugRenderer);
+		}
+		else if (draw_parallel)
+			mDebugRenderer->DrawBodies(physics_system, job_system);
+		else
+			body_instances.Draw(physics_system);
 
-		BodyManager::DrawSettings settings;
-		physics_system.DrawBodies(settings, mDebugRenderer);
+		// Labels are only queued here, all of them go out in one draw call at the end of the frame
+		if (draw_labels)
+		{
+			BodyIDVector label_bodies;
+			physics_system.GetBodies(label_bodies);
+			for (const BodyID &id : label_bodies)
+			{
+				char label[64];
+				snprintf(label, sizeof(label), "#%u %.1f m/s", id.GetIndex(), double(body_interface.GetLinearVelocity(id).Length()));
+				mDebugRenderer->DrawText3D(body_interface.GetCenterOfMassPosition(id) + Vec3(0, 1.2f, 0), label, Color::sWhite, 0.3f);
+			}
+		}
 
-		glfwSwapBuffers(mDebugRenderer->window);
-    	glfwPollEvents();
+		mDebugRenderer->EndFrame();
 
-		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		// Offscreen runs are batch jobs, no need to slow them down to watching speed. Otherwise sleep what's left of
+		// the 50 ms frame, so the frame rate doesn't depend on how long the frame took.
+		if (!mDebugRenderer->IsOffscreen())
+		{
+			next_frame = max(next_frame + std::chrono::milliseconds(50), std::chrono::steady_clock::now());
+			std::this_thread::sleep_until(next_frame);
+		}
 #endif // JPH_DEBUG_RENDERER
 
 		// If you take larger steps than 1 / 60th of a second you need to do multiple collision steps in order to keep the simulation stable. Do 1 collision step per 1 / 60th of a second (round up).
 		const int cCollisionSteps = 1;
 
 		// Step the world
-		physics_system.Update(cDeltaTime, cCollisionSteps, &temp_allocator, &job_system);
+		mDebugRenderer->GetProfiler().BeginCpu(FrameSection::Update);
+		if (telemetry.IsOpen())
+			step_meter.Begin();
+		EPhysicsUpdateError errors = physics_system.Update(cDeltaTime, cCollisionSteps, &temp_allocator, &job_system);
+		mDebugRenderer->GetProfiler().EndCpu(FrameSection::Update);
+		capacity_monitor.AfterUpdate(physics_system, errors, cCollisionSteps);
+
+		// Copy the stats of this step into shared memory, whether or not a viewer is attached
+		if (telemetry.IsOpen())
+		{
+			step_meter.End(job_system.GetMaxConcurrency());
+			AllocationStats allocations = GetAllocationStats();
+			TelemetrySample sample;
+			sample.frame = step;
+			sample.stepMs = step_meter.LastMs();
+			sample.jobUtilization = step_meter.LastUtilization();
+			sample.numThreads = uint32(job_system.GetMaxConcurrency());
+			sample.numBodies = physics_system.GetNumBodies();
+			sample.numActiveBodies = physics_system.GetNumActiveBodies(EBodyType::RigidBody);
+			sample.numContacts = capacity_monitor.GetStats().contactsLastUpdate;
+			sample.heapLiveBytes = allocations.liveBytes;
+			sample.heapPeakBytes = allocations.peakBytes;
+			sample.numAllocations = allocations.numAllocations;
+			telemetry.Publish(sample);
+		}
 	}
 
+	// Tell how close we came to the limits, the next run can pick up the recommended capacities
+	capacity_monitor.Report();
+	if (capacity_file != nullptr && !capacity_monitor.SaveRecommendation(capacity_file))
+		cerr << "Error: could not write " << capacity_file << endl;
+
 	// Remove the sphere from the physics system. Note that the sphere itself keeps all of its state and can be re-added at any time.
 	body_interface.RemoveBody(sphere_id);
 
 	// Destroy the sphere. After this the sphere ID is no longer valid.
 	body_interface.DestroyBody(sphere_id);
+	body_instances.BodyRemoved(sphere_id);
 
 	// Remove and destroy the floor
 	body_interface.RemoveBody(floor->GetID());
+	body_instances.BodyRemoved(floor->GetID());
 	body_interface.DestroyBody(floor->GetID());
 
+	// Flushes the frames still in flight and releases the GL context
+	delete mDebugRenderer;
+
 	// Unregisters all types with the factory and cleans up the default material
 	UnregisterTypes();
 
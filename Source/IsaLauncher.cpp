@@ -0,0 +1,238 @@
+// Jolt Physics Library (https://github.com/jrouwe/JoltPhysics)
+// SPDX-FileCopyrightText: 2021 Jorrit Rouwe
+// SPDX-License-Identifier: MIT
+
+// Launcher of a MULTI_ISA build (see Build/CMakeLists.txt). Reads CPUID, picks the highest ISA level that both the CPU and the
+// OS support and runs LAUNCHER_TARGET from the directory of that level next to this executable with the same arguments.
+// This file is compiled for plain x86-64 and doesn't use Jolt, so it runs anywhere the SSE2 variant runs.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#include <windows.h>
+	#include <intrin.h>
+#else
+	#include <cpuid.h>
+	#include <unistd.h>
+	#include <sys/stat.h>
+#endif
+
+#if !defined(__x86_64__) && !defined(_M_X64)
+	#error The ISA launcher only supports x86-64
+#endif
+
+#ifndef LAUNCHER_TARGET
+	#error Define LAUNCHER_TARGET as the name of the executable to launch
+#endif
+
+using namespace std;
+
+// In order of preference from low to high, names match ISA_LEVEL
+enum class EIsaLevel
+{
+	SSE2,
+	AVX2,
+	AVX512,
+	Count
+};
+
+static const char *sIsaLevelNames[] = { "SSE2", "AVX2", "AVX512" };
+
+static void sCpuid(unsigned int inLeaf, unsigned int inSubLeaf, unsigned int outRegisters[4])
+{
+#ifdef _MSC_VER
+	int registers[4];
+	__cpuidex(registers, int(inLeaf), int(inSubLeaf));
+	memcpy(outRegisters, registers, sizeof(registers));
+#else
+	__cpuid_count(inLeaf, inSubLeaf, outRegisters[0], outRegisters[1], outRegisters[2], outRegisters[3]);
+#endif
+}
+
+// Register state the OS saves on a context switch (XCR0)
+static unsigned long long sGetEnabledRegisterState()
+{
+#ifdef _MSC_VER
+	return _xgetbv(0);
+#else
+	unsigned int eax, edx;
+	__asm__ volatile ("xgetbv" : "=a" (eax), "=d" (edx) : "c" (0));
+	return (static_cast<unsigned long long>(edx) << 32) | eax;
+#endif
+}
+
+static bool sHasBit(unsigned int inRegister, int inBit)
+{
+	return (inRegister & (1u << inBit)) != 0;
+}
+
+// Highest level that the CPU executes and the OS supports. The AVX2 level has to match everything Jolt enables
+// with USE_AVX2 and friends, the AVX512 level everything it enables with USE_AVX512.
+static EIsaLevel sDetectIsaLevel()
+{
+	unsigned int regs[4]; // eax, ebx, ecx, edx
+	sCpuid(0, 0, regs);
+	unsigned int max_leaf = regs[0];
+
+	sCpuid(1, 0, regs);
+	unsigned int ecx1 = regs[2];
+	bool sse4_1 = sHasBit(ecx1, 19), sse4_2 = sHasBit(ecx1, 20), popcnt = sHasBit(ecx1, 23);
+	bool fma = sHasBit(ecx1, 12), avx = sHasBit(ecx1, 28), f16c = sHasBit(ecx1, 29);
+
+	// Without OSXSAVE the OS doesn't save the YMM/ZMM registers and AVX can't be used
+	if (!sHasBit(ecx1, 27) || max_leaf < 7)
+		return EIsaLevel::SSE2;
+	unsigned long long xcr0 = sGetEnabledRegisterState();
+	bool os_avx = (xcr0 & 0x6) == 0x6; // XMM and YMM
+	bool os_avx512 = (xcr0 & 0xe6) == 0xe6; // and opmask, ZMM0-15 upper halves, ZMM16-31
+
+	sCpuid(7, 0, regs);
+	unsigned int ebx7 = regs[1];
+	bool bmi1 = sHasBit(ebx7, 3), avx2 = sHasBit(ebx7, 5);
+	bool avx512f = sHasBit(ebx7, 16), avx512dq = sHasBit(ebx7, 17), avx512vl = sHasBit(ebx7, 31);
+
+	sCpuid(0x80000000, 0, regs);
+	bool lzcnt = false;
+	if (regs[0] >= 0x80000001)
+	{
+		sCpuid(0x80000001, 0, regs);
+		lzcnt = sHasBit(regs[2], 5);
+	}
+
+	if (!(os_avx && sse4_1 && sse4_2 && popcnt && avx && avx2 && fma && f16c && bmi1 && lzcnt))
+		return EIsaLevel::SSE2;
+	if (!(os_avx512 && avx512f && avx512dq && avx512vl))
+		return EIsaLevel::AVX2;
+	return EIsaLevel::AVX512;
+}
+
+static string sGetExecutableDirectory(const char *inArgv0)
+{
+	string path;
+#ifdef _WIN32
+	char buffer[MAX_PATH];
+	DWORD length = GetModuleFileNameA(nullptr, buffer, MAX_PATH);
+	if (length > 0 && length < MAX_PATH)
+		path.assign(buffer, length);
+#else
+	char buffer[4096];
+	ssize_t length = readlink("/proc/self/exe", buffer, sizeof(buffer));
+	if (length > 0 && size_t(length) < sizeof(buffer))
+		path.assign(buffer, size_t(length));
+#endif
+	if (path.empty())
+		path = inArgv0;
+
+	size_t separator = path.find_last_of("/\\");
+	return separator != string::npos? path.substr(0, separator + 1) : string("./");
+}
+
+static string sGetVariantPath(const string &inDirectory, EIsaLevel inLevel)
+{
+	string path = inDirectory + sIsaLevelNames[int(inLevel)] + "/" LAUNCHER_TARGET;
+#ifdef _WIN32
+	path += ".exe";
+#endif
+	return path;
+}
+
+static bool sFileExists(const string &inPath)
+{
+#ifdef _WIN32
+	return GetFileAttributesA(inPath.c_str()) != INVALID_FILE_ATTRIBUTES;
+#else
+	struct stat info;
+	return stat(inPath.c_str(), &info) == 0;
+#endif
+}
+
+// Runs the variant with the arguments of this process, returns its exit code
+static int sRun(const string &inPath, char **inArgv)
+{
+#ifdef _WIN32
+	(void)inArgv;
+
+	// Keep the arguments exactly as they were quoted by skipping the program name in our own command line
+	const char *arguments = GetCommandLineA();
+	if (*arguments == '"')
+	{
+		arguments = strchr(arguments + 1, '"');
+		arguments = arguments != nullptr? arguments + 1 : "";
+	}
+	else
+		while (*arguments != 0 && *arguments != ' ' && *arguments != '\t')
+			++arguments;
+	string command_line = "\"" + inPath + "\"" + arguments;
+
+	STARTUPINFOA startup_info = {};
+	startup_info.cb = sizeof(startup_info);
+	PROCESS_INFORMATION process_info = {};
+	if (!CreateProcessA(inPath.c_str(), &command_line[0], nullptr, nullptr, FALSE, 0, nullptr, nullptr, &startup_info, &process_info))
+	{
+		fprintf(stderr, "Error: could not start %s\n", inPath.c_str());
+		return 1;
+	}
+	WaitForSingleObject(process_info.hProcess, INFINITE);
+	DWORD exit_code = 1;
+	GetExitCodeProcess(process_info.hProcess, &exit_code);
+	CloseHandle(process_info.hThread);
+	CloseHandle(process_info.hProcess);
+	return int(exit_code);
+#else
+	// Replace this process so signals, the exit code and the terminal go straight to the variant
+	inArgv[0] = const_cast<char *>(inPath.c_str());
+	execv(inPath.c_str(), inArgv);
+	fprintf(stderr, "Error: could not start %s\n", inPath.c_str());
+	return 1;
+#endif
+}
+
+int main(int argc, char** argv)
+{
+	(void)argc;
+
+	EIsaLevel supported = sDetectIsaLevel();
+	EIsaLevel level = supported;
+
+	// JOLT_ISA forces a level, e.g. to compare them on the same machine
+	const char *forced = getenv("JOLT_ISA");
+	bool is_forced = forced != nullptr && *forced != 0;
+	if (is_forced)
+	{
+		int i = 0;
+		while (i < int(EIsaLevel::Count) && strcmp(forced, sIsaLevelNames[i]) != 0)
+			++i;
+		if (i == int(EIsaLevel::Count))
+		{
+			fprintf(stderr, "Error: JOLT_ISA=%s, use SSE2, AVX2 or AVX512\n", forced);
+			return 1;
+		}
+		if (i > int(supported))
+		{
+			fprintf(stderr, "Error: JOLT_ISA=%s is not supported by this CPU (up to %s)\n", forced, sIsaLevelNames[int(supported)]);
+			return 1;
+		}
+		level = EIsaLevel(i);
+	}
+
+	// Fall back to a lower level when the variant wasn't built (see MULTI_ISA_LEVELS), unless the level was forced
+	string directory = sGetExecutableDirectory(argv[0]);
+	int lowest = is_forced? int(level) : 0;
+	for (int i = int(level); i >= lowest; --i)
+	{
+		string path = sGetVariantPath(directory, EIsaLevel(i));
+		if (sFileExists(path))
+		{
+			if (getenv("JOLT_ISA_VERBOSE") != nullptr)
+				fprintf(stderr, "Starting %s (CPU supports up to %s)\n", path.c_str(), sIsaLevelNames[int(supported)]);
+			return sRun(path, argv);
+		}
+	}
+
+	fprintf(stderr, "Error: no variant of " LAUNCHER_TARGET " for %s%s in %s\n", sIsaLevelNames[int(level)], is_forced? "" : " or lower", directory.c_str());
+	return 1;
+}
@@ -0,0 +1,184 @@
+// Jolt Physics Library (https://github.com/jrouwe/JoltPhysics)
+// SPDX-FileCopyrightText: 2021 Jorrit Rouwe
+// SPDX-License-Identifier: MIT
+
+// Attaches to the telemetry ring of a running HelloWorld (--telemetry) and shows its stats in the terminal.
+// The viewer only reads the shared memory, the simulation doesn't notice whether it runs or not.
+
+#include <Jolt/Jolt.h>
+
+// STL includes
+#include <iostream>
+#include <iomanip>
+#include <cstdarg>
+#include <thread>
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <deque>
+#include <algorithm>
+
+#include "telemetry.hpp"
+
+// Disable common warnings triggered by Jolt, you can use JPH_SUPPRESS_WARNING_PUSH / JPH_SUPPRESS_WARNING_POP to store and restore the warning state
+JPH_SUPPRESS_WARNINGS
+
+using namespace JPH;
+using namespace std;
+
+// Callback for traces
+static void TraceImpl(const char *inFMT, ...)
+{
+	va_list list;
+	va_start(list, inFMT);
+	char buffer[1024];
+	vsnprintf(buffer, sizeof(buffer), inFMT, list);
+	va_end(list);
+
+	cerr << buffer << endl;
+}
+
+static void PrintUsage()
+{
+	cout << "Usage: TelemetryViewer [options]" << endl
+		 << "  --name <name>            shared memory name the simulation publishes under (default /jolt_telemetry)" << endl
+		 << "  --interval <ms>          refresh interval (default 250)" << endl
+		 << "  --csv                    print every sample as a CSV line instead of a live table" << endl;
+}
+
+// Bar graph of inValues in one line of characters, scaled to the largest value
+static string sSparkline(const vector<float> &inValues)
+{
+	static const char cLevels[] = " .:-=+*#%@";
+	float max_value = 0.0f;
+	for (float v : inValues)
+		max_value = max(max_value, v);
+
+	string line;
+	for (float v : inValues)
+		line += cLevels[max_value > 0.0f? int(v / max_value * 9.0f + 0.5f) : 0];
+	return line;
+}
+
+static void sPrintCsvHeader()
+{
+	cout << "frame,time,step_ms,job_utilization,threads,bodies,active_bodies,contacts,heap_live_bytes,heap_peak_bytes,allocations" << endl;
+}
+
+static void sPrintCsv(const TelemetrySample &inSample)
+{
+	cout << inSample.frame << "," << fixed << setprecision(4) << inSample.time << "," << inSample.stepMs << "," << inSample.jobUtilization << defaultfloat
+		 << "," << inSample.numThreads << "," << inSample.numBodies << "," << inSample.numActiveBodies << "," << inSample.numContacts
+		 << "," << inSample.heapLiveBytes << "," << inSample.heapPeakBytes << "," << inSample.numAllocations << endl;
+}
+
+// Live table of the latest sample and the stats of the last second
+static void sPrintTable(const string &inName, const deque<TelemetrySample> &inHistory, uint64 inLost)
+{
+	const TelemetrySample &last = inHistory.back();
+
+	// Everything within a second of the latest sample
+	float step_sum = 0.0f, step_max = 0.0f, utilization_sum = 0.0f;
+	int count = 0;
+	const TelemetrySample *first = &last;
+	for (auto it = inHistory.rbegin(); it != inHistory.rend() && last.time - it->time <= 1.0; ++it)
+	{
+		step_sum += it->stepMs;
+		step_max = max(step_max, it->stepMs);
+		utilization_sum += it->jobUtilization;
+		first = &*it;
+		++count;
+	}
+	double span = last.time - first->time;
+	double allocations_per_second = span > 0.0? double(last.numAllocations - first->numAllocations) / span : 0.0;
+
+	vector<float> recent;
+	for (size_t i = inHistory.size() > 60? inHistory.size() - 60 : 0; i < inHistory.size(); ++i)
+		recent.push_back(inHistory[i].stepMs);
+
+	cout << "\033[H\033[2J";
+	cout << inName << "  frame " << last.frame << "  t = " << fixed << setprecision(1) << last.time << " s" << endl << endl;
+	cout << setprecision(3);
+	cout << "step        " << setw(8) << last.stepMs << " ms   avg " << setw(8) << step_sum / count << " ms   max " << setw(8) << step_max << " ms  (last second)" << endl;
+	cout << "            [" << sSparkline(recent) << "]" << endl;
+	cout << setprecision(0);
+	cout << "jobs        " << setw(8) << 100.0f * utilization_sum / count << " %  of " << last.numThreads << " threads busy during the step" << endl;
+	cout << "bodies      " << setw(8) << last.numBodies << "      active " << last.numActiveBodies << endl;
+	cout << "contacts    " << setw(8) << last.numContacts << endl;
+	cout << "heap        " << setw(8) << last.heapLiveBytes / 1024 << " KiB  peak " << last.heapPeakBytes / 1024 << " KiB  " << allocations_per_second << " allocations/s" << endl;
+	cout << defaultfloat;
+	if (inLost > 0)
+		cout << endl << inLost << " samples missed" << endl;
+	cout << flush;
+}
+
+int main(int argc, char** argv)
+{
+	string name = "/jolt_telemetry";
+	int interval_ms = 250;
+	bool csv = false;
+	for (int i = 1; i < argc; ++i)
+	{
+		string arg = argv[i];
+		if (arg == "--name" && i + 1 < argc)
+			name = argv[++i];
+		else if (arg == "--interval" && i + 1 < argc)
+			interval_ms = max(10, atoi(argv[++i]));
+		else if (arg == "--csv")
+			csv = true;
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	Trace = TraceImpl;
+
+	TelemetryReader reader;
+	deque<TelemetrySample> history;
+	vector<TelemetrySample> samples;
+	uint64 lost = 0;
+	bool waiting_reported = false;
+	if (csv)
+		sPrintCsvHeader();
+
+	for (;;)
+	{
+		// Follow the simulation across restarts
+		if (reader.IsStale())
+			reader.Detach();
+		if (!reader.IsAttached())
+		{
+			if (!reader.Attach(name.c_str()))
+			{
+				if (!waiting_reported)
+					cerr << "Waiting for a simulation publishing to " << name << "..." << endl;
+				waiting_reported = true;
+				this_thread::sleep_for(chrono::milliseconds(500));
+				continue;
+			}
+			waiting_reported = false;
+			history.clear();
+		}
+
+		samples.clear();
+		lost += reader.ReadNew(samples);
+		for (const TelemetrySample &sample : samples)
+		{
+			if (csv)
+				sPrintCsv(sample);
+			history.push_back(sample);
+			if (history.size() > 4096)
+				history.pop_front();
+		}
+
+		if (!csv && !history.empty())
+			sPrintTable(name, history, lost);
+
+		this_thread::sleep_for(chrono::milliseconds(interval_ms));
+	}
+
+	return 0;
+}